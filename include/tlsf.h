@@ -14,16 +14,26 @@
 extern "C" {
 #endif /* __cplusplus */
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
 /*
- * Second-level subdivisions: 32 bins per first-level class.
- * Max internal fragmentation bounded by 1/SL_COUNT = 3.125% (was 6.25%
- * with 16 bins). Control structure size increases ~2x for the block
- * pointer array.
+ * Second-level subdivisions: 2^TLSF_SL_SHIFT bins per first-level class.
+ * Max internal fragmentation is bounded by 1/SL_COUNT:
+ *   TLSF_SL_SHIFT 4: 16 bins, 6.25%,  smallest tlsf_t
+ *   TLSF_SL_SHIFT 5: 32 bins, 3.125% (default)
+ *   TLSF_SL_SHIFT 6: 64 bins, 1.56%,  64-bit SL bitmaps, ~2x block[][]
+ * Each step doubles the block pointer array (the bulk of tlsf_t) and
+ * raises BLOCK_SIZE_SMALL, the linear-binning threshold.
  */
-#define _TLSF_SL_COUNT 32
+#ifndef TLSF_SL_SHIFT
+#define TLSF_SL_SHIFT 5
+#endif
+#if TLSF_SL_SHIFT < 4 || TLSF_SL_SHIFT > 6
+#error "TLSF_SL_SHIFT must be 4, 5 or 6"
+#endif
+#define _TLSF_SL_COUNT (1 << TLSF_SL_SHIFT)
 
 /*
  * Configurable maximum pool size: define TLSF_MAX_POOL_BITS to clamp
@@ -33,6 +43,8 @@ extern "C" {
  */
 #ifdef TLSF_MAX_POOL_BITS
 #define _TLSF_FL_MAX TLSF_MAX_POOL_BITS
+#elif defined(TLSF_COMPACT)
+#define _TLSF_FL_MAX 32
 #else
 #if __SIZE_WIDTH__ == 64
 #define _TLSF_FL_MAX 39
@@ -41,16 +53,123 @@ extern "C" {
 #endif
 #endif
 
-/* FL_SHIFT = log2(SL_COUNT) + log2(ALIGN_SIZE) */
+/*
+ * Compact layout (64-bit only): define TLSF_COMPACT to replace the
+ * free-list and bin pointers with 32-bit offsets from the pool base, and
+ * to keep the previous-block link in the upper half of the block header
+ * instead of the previous block's payload tail.  This halves the bin
+ * array in tlsf_t and the minimum block size (24 -> 8 bytes), at the
+ * cost of pools limited to 4 GB.  On 32-bit targets pointers are already
+ * 32 bits wide, so the mode is rejected.
+ */
+#ifdef TLSF_COMPACT
+#if __SIZE_WIDTH__ != 64
+#error "TLSF_COMPACT requires a 64-bit target"
+#endif
+#if _TLSF_FL_MAX > 32
+#error "TLSF_COMPACT limits TLSF_MAX_POOL_BITS to 32"
+#endif
+#endif
+
+/*
+ * Sampling heap profiler hooks (64-bit only): define TLSF_PROFILE to let
+ * a tlsf_prof_t (tlsf_prof.h, src/tlsf_prof.c) attach to a pool.  Every
+ * allocation decrements a byte countdown in tlsf_t; only when it runs out
+ * is the profiler called.  Sampled blocks carry a header bit, so free
+ * consults the profiler for those blocks alone.  The bit needs 8-byte
+ * size alignment, hence 64-bit targets.
+ */
+#if defined(TLSF_PROFILE) && __SIZE_WIDTH__ != 64
+#error "TLSF_PROFILE requires a 64-bit target"
+#endif
+
+/*
+ * Hot-field layout: define TLSF_HOT_LAYOUT to reorder tlsf_t for the
+ * small-object path of tlsf_malloc()/tlsf_free().  That path touches fl,
+ * sl[0], one block[0][*] slot and, whenever the block is first or last
+ * in its list, the free-list sentinel block_null.  The default layout
+ * keeps block_null after the whole bin array, so those fields span three
+ * cache lines; this option moves block_null ahead of fl and sl[] (one
+ * line), starts block[] on a line boundary and aligns tlsf_t itself to
+ * TLSF_CACHELINE_SIZE, leaving two lines per small-object operation.
+ *
+ * The field order is part of the ABI: every object sharing a tlsf_t must
+ * agree on the option, and a tlsf_t on the heap must come from an
+ * aligned allocator (aligned_alloc, posix_memalign).
+ */
+#ifndef TLSF_CACHELINE_SIZE
+#define TLSF_CACHELINE_SIZE 64
+#endif
+#ifdef TLSF_HOT_LAYOUT
+#define _TLSF_HOT_ALIGN __attribute__((aligned(TLSF_CACHELINE_SIZE)))
+#else
+#define _TLSF_HOT_ALIGN
+#endif
+
+/*
+ * Minimum alignment: 2^TLSF_ALIGN_SHIFT is the alignment of every payload
+ * and the granularity of every block size.  The default is the word size
+ * (8 bytes on 64-bit, 4 on 32-bit).  4, 5 or 6 give 16, 32 or 64 bytes
+ * (max_align_t, AVX2, AVX-512) from tlsf_malloc() itself, with no
+ * tlsf_aalloc() padding.  Above the word size the block header is padded
+ * to the alignment, so each block costs 2^TLSF_ALIGN_SHIFT bytes of
+ * overhead instead of one word.  The header word stays right before the
+ * payload.  Pools, including the memory tlsf_resize() returns, must be
+ * aligned to 2^TLSF_ALIGN_SHIFT.
+ */
 #if __SIZE_WIDTH__ == 64
-#define _TLSF_FL_SHIFT 8
+#define _TLSF_ALIGN_SHIFT_MIN 3
 #else
-#define _TLSF_FL_SHIFT 7
+#define _TLSF_ALIGN_SHIFT_MIN 2
+#endif
+#ifndef TLSF_ALIGN_SHIFT
+#define TLSF_ALIGN_SHIFT _TLSF_ALIGN_SHIFT_MIN
 #endif
+#if TLSF_ALIGN_SHIFT < _TLSF_ALIGN_SHIFT_MIN || TLSF_ALIGN_SHIFT > 6
+#error "TLSF_ALIGN_SHIFT must be between log2(sizeof(size_t)) and 6"
+#endif
+#define _TLSF_ALIGN_SIZE ((size_t) 1 << TLSF_ALIGN_SHIFT)
+#define _TLSF_BLOCK_OVERHEAD \
+    (_TLSF_ALIGN_SIZE > sizeof(size_t) ? _TLSF_ALIGN_SIZE : sizeof(size_t))
+
+/* FL_SHIFT = log2(SL_COUNT) + log2(ALIGN_SIZE) */
+#define _TLSF_FL_SHIFT (TLSF_SL_SHIFT + TLSF_ALIGN_SHIFT)
 #define _TLSF_FL_COUNT (_TLSF_FL_MAX - _TLSF_FL_SHIFT + 1)
-#define TLSF_MAX_SIZE (((size_t) 1 << (_TLSF_FL_MAX - 1)) - sizeof(size_t))
+
+/* Bitmap word types: one bit per FL class / SL bin.  Widened to 64 bits
+ * only when the level needs it (64 SL bins, or 33 FL classes with 16 SL
+ * bins on 64-bit), so 32-bit targets keep 32-bit scans by default.
+ */
+#if _TLSF_FL_COUNT > 32
+typedef uint64_t tlsf_flmap_t;
+#else
+typedef uint32_t tlsf_flmap_t;
+#endif
+#if _TLSF_SL_COUNT > 32
+typedef uint64_t tlsf_slmap_t;
+#else
+typedef uint32_t tlsf_slmap_t;
+#endif
+#define TLSF_MAX_SIZE \
+    (((size_t) 1 << (_TLSF_FL_MAX - 1)) - _TLSF_BLOCK_OVERHEAD)
 #define TLSF_INIT ((tlsf_t) {.size = 0})
 
+#ifdef TLSF_COMPACT
+/*
+ * Compact block header structure.
+ *
+ * header:    Bits 0-31: size | status bits (lower 2 bits).
+ *            Bits 32-63: distance in bytes back to the previous physical
+ *            block.  Only valid when the previous block is free.
+ * next_free: Offset of the next block in the same free list.
+ * prev_free: Offset of the previous block in the same free list.
+ */
+typedef uint32_t tlsf_link_t;
+struct tlsf_block {
+    size_t header;
+    tlsf_link_t next_free, prev_free;
+};
+#else
 /*
  * Block header structure.
  *
@@ -61,19 +180,114 @@ extern "C" {
  * next_free: Next block in the same free list (only valid when free).
  * prev_free: Previous block in the same free list (only valid when free).
  */
+typedef struct tlsf_block *tlsf_link_t;
 struct tlsf_block {
     struct tlsf_block *prev;
     size_t header;
-    struct tlsf_block *next_free, *prev_free;
+    tlsf_link_t next_free, prev_free;
 };
+#endif
+
+/* Operations timed under TLSF_LATENCY (rows of tlsf_latency_t). */
+enum {
+    TLSF_LAT_MALLOC,
+    TLSF_LAT_AALLOC,
+    TLSF_LAT_REALLOC,
+    TLSF_LAT_FREE,
+    TLSF_LAT_LOCK, /* Arena lock wait; recorded by tlsf_thread only */
+    TLSF_LAT_OPS,
+};
+
+#ifdef TLSF_LATENCY
+/*
+ * Per-operation latency histograms (define TLSF_LATENCY).  Every public
+ * entry point reads the tick counter on entry and exit and bumps one
+ * bucket in its tlsf_t; there is no locking beyond what already guards
+ * the pool.  Buckets are log-linear: values below 4 have their own
+ * bucket, above that each power of two is split in four, so a bucket's
+ * width is at most 25% of its lower bound.  The last bucket also holds
+ * everything beyond 2^33 ticks.
+ *
+ * Ticks are TSC cycles on x86, the generic timer on ARM64.  Other
+ * targets must define TLSF_LATENCY_TICK() to return a uint64_t counter.
+ */
+#define TLSF_LAT_BUCKETS 128
 
 typedef struct {
-    uint32_t fl, sl[_TLSF_FL_COUNT];
+    uint64_t count[TLSF_LAT_OPS][TLSF_LAT_BUCKETS];
+} tlsf_latency_t;
+
+#ifndef TLSF_LATENCY_TICK
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t tlsf_latency_tick(void)
+{
+    uint32_t lo, hi;
+    __asm__ __volatile__("lfence\n\trdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t) hi << 32) | lo;
+}
+#elif defined(__aarch64__)
+static inline uint64_t tlsf_latency_tick(void)
+{
+    uint64_t val;
+    __asm__ __volatile__("isb\n\tmrs %0, cntvct_el0" : "=r"(val));
+    return val;
+}
+#else
+#error "TLSF_LATENCY needs TLSF_LATENCY_TICK() on this target"
+#endif
+#define TLSF_LATENCY_TICK() tlsf_latency_tick()
+#endif
+
+/* Histogram bucket for a latency of v ticks. */
+static inline unsigned tlsf_latency_bucket(uint64_t v)
+{
+    if (v < 4)
+        return (unsigned) v;
+    unsigned e = 63 - (unsigned) __builtin_clzll(v);
+    unsigned b = ((e - 1) << 2) | (unsigned) ((v >> (e - 2)) & 3);
+    return b < TLSF_LAT_BUCKETS ? b : TLSF_LAT_BUCKETS - 1;
+}
+
+static inline void tlsf_latency_record(tlsf_latency_t *lat,
+                                       unsigned op,
+                                       uint64_t ticks)
+{
+    lat->count[op][tlsf_latency_bucket(ticks)]++;
+}
+#endif
+
+typedef struct {
+#ifdef TLSF_HOT_LAYOUT
+    struct tlsf_block block_null; /* Shares the first line with fl, sl[0] */
+#endif
+    tlsf_flmap_t fl;
+    tlsf_slmap_t sl[_TLSF_FL_COUNT];
     void *arena; /* Pool base address; non-NULL for fixed pools */
     size_t size;
-    struct tlsf_block *block[_TLSF_FL_COUNT][_TLSF_SL_COUNT];
+#ifdef TLSF_COMPACT
+    char *base; /* Origin of free-list offsets (first block header) */
+#endif
+    tlsf_link_t block[_TLSF_FL_COUNT][_TLSF_SL_COUNT] _TLSF_HOT_ALIGN;
+#ifndef TLSF_HOT_LAYOUT
     struct tlsf_block block_null; /* Free-list sentinel (absorbs writes) */
-} tlsf_t;
+#endif
+#ifdef TLSF_LATENCY
+    tlsf_latency_t latency;
+#endif
+#ifdef TLSF_PROFILE
+    ptrdiff_t prof_countdown; /* Bytes left until the next sample */
+    struct tlsf_prof *prof;   /* Attached profiler, or NULL */
+#endif
+} _TLSF_HOT_ALIGN tlsf_t;
+
+#ifdef TLSF_PROFILE
+/* Called by the allocator; defined in tlsf_prof.c.  tlsf_prof_sample()
+ * records a block once the countdown runs out and returns whether the
+ * block was sampled; tlsf_prof_release() drops a sampled block.
+ */
+bool tlsf_prof_sample(tlsf_t *t, void *ptr, size_t size);
+void tlsf_prof_release(tlsf_t *t, void *ptr);
+#endif
 
 /**
  * Callback to grow or query the memory arena (dynamic pools only).
@@ -120,7 +334,8 @@ size_t tlsf_append_pool(tlsf_t *tlsf, void *mem, size_t size);
  * Multiple independent instances are supported by initializing separate
  * tlsf_t structures with their own memory regions.
  *
- * @param t     The TLSF allocator instance (will be zero-initialized)
+ * @param t     The TLSF allocator instance (will be initialized; the bin
+ *              heads are not written, see tlsf_pool_reset())
  * @param mem   Pointer to the memory region to use as the pool
  * @param bytes Total size of the memory region in bytes
  * @return      Usable bytes in the pool, or 0 on failure
@@ -129,9 +344,9 @@ size_t tlsf_pool_init(tlsf_t *t, void *mem, size_t bytes);
 
 /**
  * Reset a static pool to its initial state, discarding all allocations.
- * Bounded-time bulk deallocation: clears bitmaps, recreates a single
- * free block.  Cost is O(FL_COUNT * SL_COUNT) for the bin reset, which
- * is fixed at compile time.
+ * Bounded-time bulk deallocation: clears the bitmaps and recreates a
+ * single free block.  The bin heads are left as they are, so the cost is
+ * O(FL_COUNT) and independent of SL_COUNT and of the pool size.
  *
  * Only valid for pools created with tlsf_pool_init().
  * Does nothing for dynamic pools or uninitialized instances.
@@ -145,6 +360,97 @@ size_t tlsf_pool_init(tlsf_t *t, void *mem, size_t bytes);
  */
 void tlsf_pool_reset(tlsf_t *t);
 
+/* Flags for tlsf_pool_prefault(). */
+enum {
+    TLSF_PREFAULT_LOCK = 1 << 0, /* Also mlock() the pool */
+};
+
+/**
+ * Fault in every page of the pool ahead of time, so that neither the
+ * allocator nor the first store to a new allocation takes a page fault
+ * later.  Each page gets one atomic compare-and-swap of a byte with
+ * itself: the page is mapped writable, its contents are unchanged, and
+ * blocks in use by other threads may be written concurrently.  With
+ * TLSF_PREFAULT_LOCK the pool is also locked in RAM, so the pages cannot
+ * be swapped or reclaimed afterwards.
+ *
+ * Covers a static pool including appended memory, or the current extent
+ * of a dynamic pool (located with tlsf_resize(t, t->size)).  Pages a
+ * dynamic pool gains by growing later are not covered: call it again
+ * after growing, or build with TLSF_GROW_CHUNK and TLSF_SHRINK_RETAIN to
+ * keep the extent stable.  Locked pages stay locked until unmapped or
+ * munlock()ed.
+ *
+ * Cost is O(pool size / page size) plus the faults themselves.
+ *
+ * @param t     The TLSF allocator instance
+ * @param flags 0 or TLSF_PREFAULT_LOCK
+ * @return 0 on success, -1 if t is NULL, locking failed (errno is left
+ *         as mlock() set it) or locking is unsupported on this target
+ */
+int tlsf_pool_prefault(tlsf_t *t, unsigned flags);
+
+/**
+ * Pre-split part of the pool into @count free blocks sized for
+ * tlsf_malloc(t, @size), each filed in the bin that such a request
+ * searches first.  Those allocations then take the shortest path: an
+ * exact bin hit with no split and no remainder to insert, instead of
+ * splitting one large free block.
+ *
+ * The reserved blocks sit between used fence blocks of the minimum
+ * size, one before the run and one after each block, so none of them
+ * ever coalesces with its neighbours: once freed it goes back to the
+ * same bin, and the reservation survives any number of malloc/free
+ * cycles.  Other requests may still take reserved blocks, trimming them,
+ * when their own bins are empty.
+ *
+ * The fences are a cost until tlsf_unreserve() or tlsf_pool_reset()
+ * drops them, see tlsf_get_stats().
+ *
+ * The blocks are cut from one free block, which a dynamic pool grows to
+ * provide.  Cost is O(@count).
+ *
+ * @param t     The TLSF allocator instance
+ * @param size  Request size the blocks are for (as for tlsf_malloc)
+ * @param count Number of blocks to carve
+ * @return Handle for tlsf_unreserve(), or NULL if t is NULL, @count is 0
+ *         or no free block holds the run (the pool is left unchanged)
+ */
+void *tlsf_reserve(tlsf_t *t, size_t size, size_t count);
+
+/**
+ * Drop the fences of a reservation.  Reserved blocks that are free
+ * coalesce with their neighbours at once, the others when they are
+ * freed, as for any block.  Cost is O(count) of the reservation.
+ *
+ * @param t       The TLSF allocator instance
+ * @param reserve Handle returned by tlsf_reserve() on this pool since the
+ *                last tlsf_pool_reset(), or NULL (no-op)
+ */
+void tlsf_unreserve(tlsf_t *t, void *reserve);
+
+/**
+ * Reconstruct the control structure of a static pool from its physical
+ * block chain, discarding whatever t held.  Block sizes and free bits
+ * are read from the block headers; bitmaps, bins, free-list links and
+ * boundary tags are rebuilt, and adjacent free blocks are coalesced.
+ * Allocated blocks are left untouched.
+ *
+ * Cost is one pass over the block headers, O(blocks).  Use it to resume
+ * a pool whose tlsf_t was lost or is stale: after a crash in a persistent
+ * heap, or to clone or snapshot a pool by copying only its arena (the
+ * copy may live at a different address; nothing in the arena is an
+ * absolute pointer once rebuilt).
+ *
+ * @param t     The TLSF allocator instance (overwritten)
+ * @param arena Pool start (t->arena of a static pool), or NULL to rebuild
+ *              a dynamic pool at tlsf_resize(t, size), which stays dynamic
+ * @param size  Pool size in bytes: the value of t->size
+ * @return 0 on success, -1 if the chain is malformed (t and the pool are
+ *         left untouched)
+ */
+int tlsf_rebuild(tlsf_t *t, void *arena, size_t size);
+
 /**
  * Allocate memory from the pool.
  *
@@ -152,17 +458,61 @@ void tlsf_pool_reset(tlsf_t *t);
  * @param size Requested allocation size in bytes.  A zero @size request
  *             returns a unique minimum-sized allocation (POSIX-compatible
  *             behavior), not NULL.
- * @return Pointer to at least @size bytes, aligned to ALIGN_SIZE (8 on
- *         64-bit, 4 on 32-bit), or NULL on failure.
+ * @return Pointer to at least @size bytes, aligned to
+ *         2^TLSF_ALIGN_SHIFT, or NULL on failure.
  */
 void *tlsf_malloc(tlsf_t *, size_t size);
 void *tlsf_realloc(tlsf_t *, void *, size_t);
 
+/**
+ * Allocate memory and report its real capacity, so that containers can
+ * use the slack left by size rounding instead of reallocating into it.
+ *
+ * @param t      The TLSF allocator instance
+ * @param size   Requested allocation size in bytes (as for tlsf_malloc)
+ * @param usable If non-NULL, receives tlsf_usable_size() of the result,
+ *               or 0 on failure
+ * @return Pointer to at least @size bytes, or NULL on failure
+ */
+void *tlsf_malloc_usable(tlsf_t *t, size_t size, size_t *usable);
+
+/**
+ * Grow an allocation in place, never moving it.  Only the free block
+ * physically following @ptr is absorbed (the first phase of
+ * tlsf_realloc()); the block is grown to @preferred bytes if that much is
+ * free, else to as much as is free, provided that reaches @min.  Any
+ * surplus goes back to the pool.  The allocation is never shrunk.
+ *
+ * Timed as a realloc under TLSF_LATENCY.
+ *
+ * @param t         The TLSF allocator instance
+ * @param ptr       Pointer previously returned by tlsf_malloc/aalloc/realloc
+ * @param min       Size the allocation must reach
+ * @param preferred Size to grow to if possible; values below @min are
+ *                  treated as @min
+ * @return New usable size (at least @min), or 0 if the allocation could
+ *         not reach @min in place; it is then unchanged
+ */
+size_t tlsf_try_expand(tlsf_t *t, void *ptr, size_t min, size_t preferred);
+
 /**
  * Releases the previously allocated memory, given the pointer.
  */
 void tlsf_free(tlsf_t *, void *);
 
+/**
+ * Release several blocks at once.  Same result as calling tlsf_free() on
+ * each pointer in order (NULL entries are skipped), but the header and
+ * bin cache misses of later pointers are prefetched while earlier ones
+ * are freed, so scattered blocks cost closer to one miss each than to a
+ * chain of them.
+ *
+ * @param t    The TLSF allocator instance
+ * @param ptrs Pointers to release; the array itself is not modified
+ * @param n    Number of entries in @ptrs
+ */
+void tlsf_free_batch(tlsf_t *t, void *const *ptrs, size_t n);
+
 /**
  * Return the usable size of an existing allocation.
  * The usable size may exceed the originally requested size due to
@@ -198,12 +548,91 @@ typedef struct {
 
 /**
  * Collect heap statistics by walking all blocks.
+ *
+ * A tlsf_reserve() of count blocks leaves count + 1 fences in use until
+ * tlsf_unreserve() or tlsf_pool_reset(): they add to total_used,
+ * block_count and overhead, a minimum block plus its header each (32
+ * bytes in the default 64-bit build).  They also keep the reserved
+ * blocks apart, so free_count, the histogram and its fragmentation
+ * indices count those blocks separately even when all are free, and a
+ * dynamic pool cannot shrink below the last fence.
+ *
  * @param t The TLSF allocator instance
  * @param stats Output structure to fill with statistics
  * @return 0 on success, -1 if t or stats is NULL
  */
 int tlsf_get_stats(tlsf_t *t, tlsf_stats_t *stats);
 
+/**
+ * Free-block histogram over the FL/SL bins, with derived fragmentation
+ * indices.  Fragmentation values are fixed-point per-mille (0..1000) so
+ * the core stays free of floating point.
+ *
+ * The structure is large (two FL_COUNT x SL_COUNT arrays, about 16 KB on
+ * 64-bit); avoid placing it on small RTOS stacks.
+ */
+typedef struct {
+    size_t count[_TLSF_FL_COUNT][_TLSF_SL_COUNT]; /* Free blocks per bin */
+    size_t bytes[_TLSF_FL_COUNT][_TLSF_SL_COUNT]; /* Free bytes per bin */
+    size_t total_free;   /* Sum of all free block payloads */
+    size_t largest_free; /* Largest free block */
+    size_t free_count;   /* Number of free blocks */
+    /* External fragmentation: 1000 * (1 - largest_free / total_free). */
+    uint32_t frag;
+    /* Per first-level class: share of free bytes (per-mille) held in
+     * blocks too small to satisfy a request of that class's lower bound
+     * (tlsf_bin_size(fl, 0)).  class_frag[0] is always 0.
+     */
+    uint32_t class_frag[_TLSF_FL_COUNT];
+} tlsf_histogram_t;
+
+/**
+ * Collect the free-block histogram by walking the non-empty bins only.
+ * Cost is O(FL_COUNT * SL_COUNT + free blocks); allocated blocks are never
+ * visited, unlike tlsf_get_stats().
+ *
+ * @param t    The TLSF allocator instance
+ * @param hist Output histogram
+ * @return 0 on success, -1 if t or hist is NULL
+ */
+int tlsf_get_histogram(tlsf_t *t, tlsf_histogram_t *hist);
+
+/**
+ * Smallest block size held by the FL/SL bin (fl, sl).
+ * Useful for labeling tlsf_histogram_t rows.
+ *
+ * @return Lower bound in bytes, or 0 if fl/sl is out of range
+ */
+size_t tlsf_bin_size(uint32_t fl, uint32_t sl);
+
+#ifdef TLSF_LATENCY
+/**
+ * Copy the latency histograms of a pool, then optionally clear them.
+ *
+ * @param t     The TLSF allocator instance
+ * @param lat   Output histograms
+ * @param reset Clear the pool's histograms after copying
+ * @return 0 on success, -1 if t or lat is NULL
+ */
+int tlsf_get_latency(tlsf_t *t, tlsf_latency_t *lat, bool reset);
+
+/**
+ * Lower bound, in ticks, of a histogram bucket.
+ */
+uint64_t tlsf_latency_bucket_min(unsigned bucket);
+
+/**
+ * Latency at or below which `permille` thousandths of the recorded
+ * operations of one kind fall (500 = median, 999 = p99.9, 1000 = max),
+ * reported as the upper bound of the bucket that holds it.
+ *
+ * @return Ticks, or 0 if no operation of that kind was recorded
+ */
+uint64_t tlsf_latency_percentile(const tlsf_latency_t *lat,
+                                 unsigned op,
+                                 unsigned permille);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
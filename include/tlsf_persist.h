@@ -0,0 +1,118 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * File-backed persistent TLSF heap.
+ *
+ * The file holds a header page (magic, state, the tlsf_t control
+ * structure and an application root offset) followed by a static pool.
+ * tlsf_pool_open() maps it with MAP_SHARED and hands back the tlsf_t, so
+ * the core API allocates straight into the file.  After a clean
+ * tlsf_pool_close() the next open validates the header and resumes in
+ * O(1), without touching the pool.
+ *
+ * The pool is mapped at the address recorded in the header whenever the
+ * kernel allows it, so pointers stored inside the heap stay valid across
+ * restarts.  If that range is taken, the file is mapped elsewhere and
+ * the open reports TLSF_OPEN_RELOCATED: offsets from the pool start
+ * (tlsf_pool_root() and friends) remain valid, raw pointers do not.
+ *
+ * Crash-consistency rules:
+ *   - The block chain (block sizes and free bits in the pool) is the
+ *     only authoritative metadata.  Bitmaps, bins, free-list links and
+ *     boundary tags are a cache of it.
+ *   - The header state is CLEAN only between a tlsf_pool_close(), which
+ *     flushes the pool before it writes CLEAN, and the next open, which
+ *     writes and flushes OPEN before returning.  The cache is trusted
+ *     only in the CLEAN state.
+ *   - Any other state means the previous user did not close the heap,
+ *     and open rebuilds the cache from the block chain (tlsf_rebuild).
+ *     Two adjacent free blocks left by an interrupted free are merged;
+ *     a chain torn mid-split fails the open with EINVAL and leaves the
+ *     header, state included, as it was.
+ *   - A process crash loses nothing written to the mapping.  After a
+ *     system crash only data flushed by tlsf_pool_sync() or
+ *     tlsf_pool_close() is durable, and the chain is consistent only if
+ *     no allocation or free ran after that flush.
+ *
+ * A heap must be open in at most one process at a time; there is no
+ * locking.  Use tlsf_shm for concurrent sharing.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tlsf.h"
+
+#include <stddef.h>
+
+/* tlsf_pool_open() flags */
+#define TLSF_PERSIST_CREATE 1 /* Create and format a missing or empty file */
+#define TLSF_PERSIST_VERIFY 2 /* Always rebuild from (and so validate) the
+                               * block chain, even after a clean close */
+
+typedef enum {
+    TLSF_OPEN_FAILED = -1, /* errno describes the failure */
+    TLSF_OPEN_RESUMED,     /* Clean close; control structure reused as is */
+    TLSF_OPEN_CREATED,     /* New heap formatted */
+    TLSF_OPEN_RECOVERED,   /* Rebuilt from the block chain */
+    TLSF_OPEN_RELOCATED,   /* Rebuilt at a new address; raw pointers stored
+                            * in the heap are stale, offsets are not */
+} tlsf_open_status_t;
+
+typedef struct {
+    tlsf_t *tlsf; /* Allocator in the mapping; use with tlsf_malloc() etc. */
+    char *pool;   /* Pool start, origin of heap offsets */
+    void *map;    /* Mapping of the whole file */
+    size_t size;  /* File size in bytes */
+    int fd;
+} tlsf_persist_t;
+
+/**
+ * Open a persistent heap, creating it if requested.
+ *
+ * @param p     Handle to fill in
+ * @param path  Heap file
+ * @param size  File size used when creating; ignored for existing heaps
+ * @param flags TLSF_PERSIST_* flags
+ * @return How the heap was brought up, or TLSF_OPEN_FAILED
+ */
+tlsf_open_status_t tlsf_pool_open(tlsf_persist_t *p,
+                                  const char *path,
+                                  size_t size,
+                                  int flags);
+
+/**
+ * Flush the whole heap to the file.  The heap stays open.
+ * @return 0 on success, -1 with errno set
+ */
+int tlsf_pool_sync(tlsf_persist_t *p);
+
+/**
+ * Flush the heap, mark it clean and unmap it.  The next open resumes
+ * without a rebuild.
+ * @return 0 on success, -1 with errno set (the heap is still unmapped;
+ *         the next open will rebuild)
+ */
+int tlsf_pool_close(tlsf_persist_t *p);
+
+/**
+ * Application root object: a single pointer kept in the header so the
+ * application can find its data again after reopening.  Stored as an
+ * offset, so it survives relocation.
+ */
+void *tlsf_pool_root(const tlsf_persist_t *p);
+void tlsf_pool_set_root(tlsf_persist_t *p, void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,133 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * Sampling heap profiler for a TLSF pool.
+ *
+ * Requires tlsf.c built with -DTLSF_PROFILE.  Allocations are sampled as
+ * a Poisson process over allocated bytes: on average one sample every
+ * `rate` bytes, so a block of size s is sampled with probability
+ * 1 - exp(-s / rate) and large blocks are almost always seen.  Each
+ * sample records the call stack that made the allocation; samples are
+ * aggregated per distinct stack into live and cumulative counts.
+ *
+ * Unsampled allocations cost one subtraction and a branch in
+ * tlsf_malloc(); unsampled frees cost one test of a header bit.  A realloc
+ * that moves the block is a free plus a malloc.  One done in place is
+ * charged only for the bytes it adds, and a sampled block is sampled
+ * again at its new size.
+ *
+ * tlsf_prof_dump() writes the tcmalloc / gperftools heap profile text
+ * format ("heap_v2"), which `pprof` reads directly.  Counts in the dump
+ * are raw samples; pprof scales them back to estimated totals using the
+ * rate recorded in the header.  Use -sample_index=inuse_space for live
+ * memory and alloc_space for everything allocated since the profiler was
+ * attached.  Build the program with frame pointers or unwind tables for
+ * complete stacks.
+ *
+ * Tables live in caller-provided memory.  When they are full, new
+ * samples are dropped and counted in `dropped`.
+ *
+ * One profiler serves one tlsf_t and is called with whatever lock guards
+ * that pool.  It is per-process: tlsf_t only holds a pointer to it, so a
+ * pool in shared or persistent memory cannot carry it across processes.
+ * tlsf_pool_open() drops any profiler a resumed heap file recorded, and
+ * tlsf_shm refuses to build with TLSF_PROFILE.  tlsf_pool_init() and
+ * tlsf_rebuild() zero the tlsf_t and so detach the profiler; attach after
+ * them.  After tlsf_pool_reset(), call tlsf_prof_reset() to forget the
+ * discarded blocks.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tlsf.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef TLSF_PROFILE
+#error "tlsf_prof.h requires -DTLSF_PROFILE"
+#endif
+
+/* Deepest call stack recorded per sample. */
+#ifndef TLSF_PROF_DEPTH
+#define TLSF_PROF_DEPTH 32
+#endif
+
+/* Default mean bytes between samples, as in tcmalloc. */
+#define TLSF_PROF_RATE ((size_t) 512 * 1024)
+
+/* Samples aggregated by call stack. */
+typedef struct {
+    uint64_t hash;
+    uint32_t depth;
+    size_t live_count, live_bytes;   /* Samples not yet freed */
+    size_t alloc_count, alloc_bytes; /* All samples */
+    void *pc[TLSF_PROF_DEPTH];
+} tlsf_prof_stack_t;
+
+/* One sampled, still allocated block. */
+typedef struct {
+    void *ptr; /* NULL when the slot is empty */
+    size_t size;
+    uint32_t stack;
+} tlsf_prof_live_t;
+
+typedef struct tlsf_prof {
+    tlsf_t *tlsf;
+    size_t rate;   /* Mean bytes between samples */
+    uint64_t rng;  /* Sampling interval generator state */
+    size_t nstack; /* Distinct stacks recorded */
+    size_t nlive;  /* Sampled blocks still allocated */
+    size_t dropped;
+    tlsf_prof_stack_t *stacks; /* Open-addressed by stack hash */
+    tlsf_prof_live_t *live;    /* Open-addressed by block address */
+    uint32_t stack_mask, live_mask;
+} tlsf_prof_t;
+
+/**
+ * Attach a profiler to a pool and start sampling.
+ *
+ * @param p     Profiler state
+ * @param t     Initialized pool
+ * @param mem   Storage for the sample tables (pointer aligned)
+ * @param bytes Size of mem; a few hundred KB suits most programs
+ * @param rate  Mean bytes between samples, or 0 for TLSF_PROF_RATE;
+ *              1 samples every allocation
+ * @return 0 on success, -1 if mem is too small for even a small table
+ */
+int tlsf_prof_init(tlsf_prof_t *p, tlsf_t *t, void *mem, size_t bytes,
+                   size_t rate);
+
+/**
+ * Stop sampling and detach from the pool.  Sampled blocks still
+ * allocated are freed normally afterwards; the tables stay readable.
+ */
+void tlsf_prof_stop(tlsf_prof_t *p);
+
+/**
+ * Forget all samples, live and cumulative, keeping the profiler attached.
+ */
+void tlsf_prof_reset(tlsf_prof_t *p);
+
+/**
+ * Write a pprof-readable heap profile of live and cumulative samples.
+ * On Linux the mapped-libraries section is appended for symbolization.
+ * @return 0 on success, -1 on a write error
+ */
+int tlsf_prof_dump(const tlsf_prof_t *p, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,148 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * Scoped region (arena) allocator on top of a TLSF pool.
+ *
+ * Objects whose lifetimes end together, such as everything a request
+ * handler allocates, are bump-allocated out of fixed-size chunks taken
+ * from the pool with tlsf_malloc().  Nothing is freed one object at a
+ * time: tlsf_region_end() releases every allocation made since the
+ * matching tlsf_region_begin() in one step, and the pool sees one
+ * tlsf_free() per chunk at most.
+ *
+ * Released chunks go to a spare list and are reused by the next scope,
+ * so a steady-state request loop does not touch the pool at all.  Up to
+ * the `keep` count given at init is retained; any beyond that is
+ * returned to the pool.  Requests larger than a quarter of a chunk get
+ * their own block from tlsf_malloc(), freed when their scope ends.
+ *
+ * Scopes nest: each tlsf_region_begin() returns a mark, and ending a
+ * scope releases everything allocated after its mark, including inner
+ * scopes that were never ended.  Ending an outer scope invalidates the
+ * marks of its inner scopes.
+ *
+ * A region is not thread-safe; use one per thread or per request.  The
+ * underlying tlsf_t may be shared with other users under the caller's
+ * own locking.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tlsf.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Default chunk size, including the chunk header. */
+#ifndef TLSF_REGION_CHUNK
+#define TLSF_REGION_CHUNK ((size_t) 64 * 1024)
+#endif
+
+/* Alignment of tlsf_region_alloc() results, as for tlsf_malloc(). */
+#define TLSF_REGION_ALIGN _TLSF_ALIGN_SIZE
+
+typedef struct tlsf_region_chunk tlsf_region_chunk_t;
+
+typedef struct {
+    tlsf_t *tlsf;                /* Pool the chunks come from */
+    char *cur, *end;             /* Free space in the current chunk */
+    tlsf_region_chunk_t *chunks; /* Chunks in use, current first */
+    tlsf_region_chunk_t *large;  /* Dedicated large blocks, newest first */
+    tlsf_region_chunk_t *spare;  /* Released chunks kept for reuse */
+    size_t chunk_size;           /* Bytes per chunk, header included */
+    size_t nspare, keep;         /* Spare chunks held, and the cap */
+} tlsf_region_t;
+
+/* Position returned by tlsf_region_begin(). */
+typedef struct {
+    tlsf_region_chunk_t *chunk, *large;
+    char *cur;
+} tlsf_region_mark_t;
+
+/**
+ * Set up an empty region.  No memory is taken from the pool until the
+ * first allocation.
+ *
+ * @param r          Region to initialize
+ * @param t          Pool that supplies the chunks
+ * @param chunk_size Bytes per chunk, or 0 for TLSF_REGION_CHUNK; smaller
+ *                   than 1 KB is raised to 1 KB
+ * @param keep       Released chunks to retain for reuse
+ */
+void tlsf_region_init(tlsf_region_t *r, tlsf_t *t, size_t chunk_size,
+                      size_t keep);
+
+/**
+ * Return every chunk, in use or spare, to the pool.  All region pointers
+ * become invalid; the region may be used again afterwards.
+ */
+void tlsf_region_destroy(tlsf_region_t *r);
+
+/**
+ * Open a scope.  O(1), allocates nothing.
+ * @return Mark to pass to tlsf_region_end()
+ */
+static inline tlsf_region_mark_t tlsf_region_begin(const tlsf_region_t *r)
+{
+    tlsf_region_mark_t m = {r->chunks, r->large, r->cur};
+    return m;
+}
+
+/**
+ * Close a scope: release everything allocated since @m was taken.
+ * Cost is O(chunks and large blocks released), independent of the
+ * number of objects.
+ */
+void tlsf_region_end(tlsf_region_t *r, tlsf_region_mark_t m);
+
+/* Slow path of the inline allocators; not called directly. */
+void *tlsf_region_alloc_slow(tlsf_region_t *r, size_t align, size_t size);
+
+/**
+ * Allocate from the region with a specified alignment.
+ *
+ * @param align Alignment in bytes; must be a non-zero power of two
+ * @param size  Requested size; a zero @size returns a valid pointer that
+ *              may equal the next allocation's
+ * @return Pointer to @size bytes, or NULL if the pool is exhausted
+ */
+static inline void *tlsf_region_aalloc(tlsf_region_t *r,
+                                       size_t align,
+                                       size_t size)
+{
+    uintptr_t p = ((uintptr_t) r->cur + align - 1) & ~(uintptr_t) (align - 1);
+    /* cur and end are TLSF_REGION_ALIGN aligned, so rounding size up
+     * cannot step past end.
+     */
+    if (r->cur && p <= (uintptr_t) r->end && size <= (uintptr_t) r->end - p) {
+        r->cur = (char *) p +
+                 ((size + TLSF_REGION_ALIGN - 1) & ~(TLSF_REGION_ALIGN - 1));
+        return (void *) p;
+    }
+    return tlsf_region_alloc_slow(r, align, size);
+}
+
+/**
+ * Allocate from the region.  The fast path is a pointer bump.
+ * @return Pointer to @size bytes aligned to TLSF_REGION_ALIGN, or NULL
+ *         if the pool is exhausted
+ */
+static inline void *tlsf_region_alloc(tlsf_region_t *r, size_t size)
+{
+    return tlsf_region_aalloc(r, TLSF_REGION_ALIGN, size);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,142 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * Process-shared TLSF heap for shared memory segments.
+ *
+ * The whole allocator lives inside the segment: a small header, the
+ * tlsf_t control structure, then the pool.  Each process may map the
+ * segment at a different address, so nothing stored in the segment may
+ * be an absolute pointer:
+ *   - Block links use the TLSF_COMPACT layout (32-bit offsets from the
+ *     pool start, prev as a distance in the header), so this module
+ *     requires the allocator to be built with -DTLSF_COMPACT.
+ *   - The two remaining pointers in tlsf_t (arena and base) are
+ *     re-derived from the caller's mapping every time the lock is taken.
+ *     Only the lock holder ever reads them, so each process sees its own
+ *     addresses.
+ *
+ * A robust, process-shared pthread mutex guards the heap.  If a process
+ * dies while holding it, the next locker takes over and the death is
+ * counted (see tlsf_shm_owner_deaths()).  The heap itself may be left
+ * mid-update in that case; the application decides whether to validate
+ * or reset it.
+ *
+ * Pointers are only meaningful inside the process that obtained them.
+ * Exchange tlsf_shm_offset() values between processes and convert them
+ * back with tlsf_shm_ptr().
+ *
+ * AddressSanitizer keeps its shadow per process and cannot follow blocks
+ * handed between processes; build the allocator with -DTLSF_NO_ASAN_POISON
+ * when running shared heaps under ASan.
+ *
+ * Lifecycle: one process calls tlsf_shm_init() on the fresh segment;
+ * every other process calls tlsf_shm_attach() on its own mapping.
+ * tlsf_shm_destroy() is called once, after every user has detached.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tlsf.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef TLSF_COMPACT
+#error "tlsf_shm requires the position-independent TLSF_COMPACT layout"
+#endif
+#ifdef TLSF_PROFILE
+#error "tlsf_shm cannot share a heap profiler, which is per-process"
+#endif
+
+typedef struct {
+    uint32_t magic;        /* TLSF_SHM_MAGIC once initialized */
+    uint32_t layout;       /* Build fingerprint; rejects mismatched peers */
+    size_t size;           /* Segment size in bytes */
+    size_t pool;           /* Pool offset from the segment start */
+    uint32_t owner_deaths; /* Lock holders that died while holding it */
+    pthread_mutex_t lock;  /* Robust, PTHREAD_PROCESS_SHARED */
+    tlsf_t tlsf;
+} tlsf_shm_t;
+
+/**
+ * Format a shared memory segment as an empty heap.  Call once, from one
+ * process, before any peer attaches.
+ *
+ * @param mem   Start of the segment in the caller's address space
+ * @param bytes Segment size; at most TLSF_MAX_SIZE of it becomes the pool
+ * @return The heap handle (== mem), or NULL if the segment is too small
+ *         or the mutex cannot be created
+ */
+tlsf_shm_t *tlsf_shm_init(void *mem, size_t bytes);
+
+/**
+ * Attach to a segment formatted by tlsf_shm_init(), possibly mapped at a
+ * different address than the creator's.
+ *
+ * @param mem   Start of the segment in the caller's address space
+ * @param bytes Size of the caller's mapping
+ * @return The heap handle (== mem), or NULL if the segment is not a heap
+ *         built with the same configuration, or is larger than the mapping
+ */
+tlsf_shm_t *tlsf_shm_attach(void *mem, size_t bytes);
+
+/**
+ * Destroy the mutex and invalidate the segment.  Not safe with respect
+ * to any other call on the same heap, from any process.
+ */
+void tlsf_shm_destroy(tlsf_shm_t *shm);
+
+void *tlsf_shm_malloc(tlsf_shm_t *shm, size_t size);
+void *tlsf_shm_aalloc(tlsf_shm_t *shm, size_t align, size_t size);
+void *tlsf_shm_realloc(tlsf_shm_t *shm, void *ptr, size_t size);
+
+/**
+ * Free a block allocated by any process attached to the heap.
+ * Pointers outside the segment are ignored.
+ */
+void tlsf_shm_free(tlsf_shm_t *shm, void *ptr);
+
+/**
+ * Offset of ptr from the segment start, suitable for passing to another
+ * process.  NULL maps to 0, which is never a valid block offset.
+ */
+size_t tlsf_shm_offset(const tlsf_shm_t *shm, const void *ptr);
+
+/**
+ * Inverse of tlsf_shm_offset() in the caller's mapping.
+ * @return The pointer, or NULL for offset 0 or an offset past the segment
+ */
+void *tlsf_shm_ptr(tlsf_shm_t *shm, size_t offset);
+
+/**
+ * Number of times a process died while holding the heap lock.
+ */
+uint32_t tlsf_shm_owner_deaths(tlsf_shm_t *shm);
+
+/**
+ * Heap consistency check and statistics, taken under the lock.
+ */
+void tlsf_shm_check(tlsf_shm_t *shm);
+int tlsf_shm_stats(tlsf_shm_t *shm, tlsf_stats_t *stats);
+
+/**
+ * Discard every allocation from every process.  All offsets handed out
+ * so far become invalid.
+ */
+void tlsf_shm_reset(tlsf_shm_t *shm);
+
+#ifdef __cplusplus
+}
+#endif
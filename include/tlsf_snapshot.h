@@ -0,0 +1,104 @@
+/*
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * Checkpoint and roll back a static TLSF pool.
+ *
+ * A snapshot holds the tlsf_t control structure and the contents of the
+ * arena.  tlsf_restore() puts both back at the same addresses, so every
+ * pointer that was live at the snapshot is valid again and points at
+ * the data it held then.  Pointers allocated after the snapshot are gone.
+ *
+ * Two backends:
+ *   Copy  tlsf_snapshot_init() with a caller buffer of t->size bytes.
+ *         Snapshot and restore memcpy the whole arena: O(pool).
+ *   COW   tlsf_snapshot_pool_init() creates the pool itself, as a
+ *         MAP_PRIVATE mapping of a memfd (Linux).  The memfd holds the
+ *         checkpoint and writes land in private copy-on-write pages.
+ *         tlsf_snapshot() writes the dirty pages back to the memfd and
+ *         drops them; tlsf_restore() just drops them.  Dirty pages are
+ *         found via /proc/self/pagemap, so both cost O(dirty pages) plus
+ *         a scan of 8 bytes of page-table metadata per pool page.
+ *         Without pagemap access every page counts as dirty.
+ *
+ * One snapshot is kept per tlsf_snapshot_t: each tlsf_snapshot() replaces
+ * the previous one.  Use several tlsf_snapshot_t with the copy backend
+ * to keep a history.
+ *
+ * Only static pools (tlsf_pool_init) are supported.  ASan shadow state
+ * is not part of the snapshot; build with -DTLSF_NO_ASAN_POISON when
+ * restoring under AddressSanitizer.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tlsf.h"
+
+#include <stddef.h>
+
+typedef struct {
+    tlsf_t *tlsf;  /* Pool being checkpointed */
+    tlsf_t saved;  /* Control structure at the last snapshot */
+    char *arena;   /* t->arena */
+    size_t size;   /* Bytes of arena covered: t->size */
+    char *copy;    /* Copy backend: saved arena bytes */
+    int fd;        /* COW backend: memfd holding the checkpoint; else -1 */
+    int pagemap;   /* COW backend: /proc/self/pagemap, or -1 */
+    size_t mapped; /* COW backend: length of the pool mapping */
+    size_t dirty;  /* Pages written back or dropped by the last call */
+} tlsf_snapshot_t;
+
+/**
+ * Set up the copy backend for an existing static pool and take the first
+ * snapshot.
+ *
+ * @param s     Snapshot state to initialize
+ * @param t     Static pool
+ * @param buf   Storage for the arena copy
+ * @param bytes Size of buf; must be at least t->size
+ * @return 0 on success, -1 if t is not a static pool or buf is too small
+ */
+int tlsf_snapshot_init(tlsf_snapshot_t *s, tlsf_t *t, void *buf, size_t bytes);
+
+/**
+ * Create a static pool on a copy-on-write memfd mapping and take the
+ * first snapshot (of the empty pool).
+ *
+ * @param s     Snapshot state to initialize
+ * @param t     TLSF instance to initialize, as with tlsf_pool_init()
+ * @param bytes Pool size, rounded up to whole pages
+ * @return Usable bytes in the pool, or 0 on failure (errno set)
+ */
+size_t tlsf_snapshot_pool_init(tlsf_snapshot_t *s, tlsf_t *t, size_t bytes);
+
+/**
+ * Replace the snapshot with the current state of the pool.
+ * @return 0 on success, -1 on I/O failure (the old snapshot may be lost)
+ */
+int tlsf_snapshot(tlsf_snapshot_t *s);
+
+/**
+ * Roll the pool back to the last snapshot.
+ * @return 0 on success, -1 on failure
+ */
+int tlsf_restore(tlsf_snapshot_t *s);
+
+/**
+ * Release backend resources.  With the COW backend this unmaps the pool,
+ * so the tlsf_t must not be used afterwards.
+ */
+void tlsf_snapshot_destroy(tlsf_snapshot_t *s);
+
+#ifdef __cplusplus
+}
+#endif
@@ -29,7 +29,8 @@
  * Lock primitives are configurable: define TLSF_LOCK_T and the associated
  * macros BEFORE including this header to use a platform-specific primitive
  * (FreeRTOS semaphore, Zephyr k_mutex, bare-metal spinlock, etc.).
- * Default: POSIX pthread_mutex_t.
+ * Default: POSIX pthread_mutex_t.  Define TLSF_LOCK_ADAPTIVE to use the
+ * built-in spin-then-park ticket lock instead.
  */
 
 #pragma once
@@ -64,6 +65,78 @@ extern "C" {
 
 #include <pthread.h>
 
+#ifdef TLSF_LOCK_ADAPTIVE
+
+/*
+ * Adaptive ticket lock: FIFO-fair, spins for a bounded number of
+ * iterations, then parks on a futex (Linux) or yields (elsewhere).
+ *
+ * Arena critical sections are a few dozen nanoseconds, far shorter than
+ * a futex sleep/wake round trip, so a waiter almost always gets the lock
+ * while spinning.  Parking only kicks in when the holder is descheduled
+ * or the arena is heavily oversubscribed.  Tickets serve waiters in
+ * arrival order, so no thread starves under contention.
+ *
+ * TLSF_LOCK_SPIN_LIMIT bounds the spin phase (pause iterations per
+ * round).  0 disables parking entirely, yielding a pure ticket spinlock.
+ */
+#ifndef TLSF_LOCK_SPIN_LIMIT
+#define TLSF_LOCK_SPIN_LIMIT 512
+#endif
+
+typedef struct {
+    uint32_t next;   /* Next ticket to hand out */
+    uint32_t owner;  /* Ticket currently served; futex word */
+    uint32_t parked; /* Waiters sleeping (or about to) on owner */
+} tlsf_adaptive_lock_t;
+
+/* Slow paths, implemented in tlsf_thread.c. */
+void tlsf_adaptive_lock_wait(tlsf_adaptive_lock_t *l, uint32_t ticket);
+void tlsf_adaptive_lock_wake(tlsf_adaptive_lock_t *l);
+
+static inline void tlsf_adaptive_lock_init(tlsf_adaptive_lock_t *l)
+{
+    l->next = 0;
+    l->owner = 0;
+    l->parked = 0;
+}
+
+static inline void tlsf_adaptive_lock_acquire(tlsf_adaptive_lock_t *l)
+{
+    uint32_t ticket = __atomic_fetch_add(&l->next, 1, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&l->owner, __ATOMIC_ACQUIRE) != ticket)
+        tlsf_adaptive_lock_wait(l, ticket);
+}
+
+static inline int tlsf_adaptive_lock_try(tlsf_adaptive_lock_t *l)
+{
+    /* The lock is free iff no ticket is outstanding (next == owner). */
+    uint32_t owner = __atomic_load_n(&l->owner, __ATOMIC_ACQUIRE);
+    return __atomic_compare_exchange_n(&l->next, &owner, owner + 1, 0,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static inline void tlsf_adaptive_lock_release(tlsf_adaptive_lock_t *l)
+{
+    /* Only the holder writes owner.  The sequentially consistent store
+     * and load pair with the waiter's parked increment and owner re-read
+     * so that a waiter about to sleep is never missed.
+     */
+    uint32_t next = __atomic_load_n(&l->owner, __ATOMIC_RELAXED) + 1;
+    __atomic_store_n(&l->owner, next, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&l->parked, __ATOMIC_SEQ_CST))
+        tlsf_adaptive_lock_wake(l);
+}
+
+#define TLSF_LOCK_T tlsf_adaptive_lock_t
+#define TLSF_LOCK_INIT(l) tlsf_adaptive_lock_init((l))
+#define TLSF_LOCK_DESTROY(l) ((void) (l))
+#define TLSF_LOCK_ACQUIRE(l) tlsf_adaptive_lock_acquire((l))
+#define TLSF_LOCK_RELEASE(l) tlsf_adaptive_lock_release((l))
+#define TLSF_LOCK_TRY(l) tlsf_adaptive_lock_try((l))
+
+#else /* !TLSF_LOCK_ADAPTIVE */
+
 #define TLSF_LOCK_T pthread_mutex_t
 #define TLSF_LOCK_INIT(l) pthread_mutex_init((l), NULL)
 #define TLSF_LOCK_DESTROY(l) pthread_mutex_destroy((l))
@@ -71,6 +144,8 @@ extern "C" {
 #define TLSF_LOCK_RELEASE(l) pthread_mutex_unlock((l))
 #define TLSF_LOCK_TRY(l) (pthread_mutex_trylock((l)) == 0)
 
+#endif /* TLSF_LOCK_ADAPTIVE */
+
 #ifndef TLSF_THREAD_HINT
 /* Fold upper bits into lower 32 to retain entropy on 64-bit systems. */
 #define TLSF_THREAD_HINT()                    \
@@ -120,6 +195,12 @@ typedef struct {
     TLSF_LOCK_T lock;
     void *base;      /* Arena memory base (for pointer ownership) */
     size_t capacity; /* Arena memory size in bytes */
+#ifdef TLSF_LATENCY
+    /* Whole wrapper calls served by this arena, lock waits included, and
+     * the lock waits alone (TLSF_LAT_LOCK).  Updated under the lock.
+     */
+    tlsf_latency_t latency;
+#endif
 } __attribute__((aligned(TLSF_CACHELINE_SIZE))) tlsf_arena_t;
 
 typedef struct {
@@ -187,6 +268,27 @@ int tlsf_thread_stats(tlsf_thread_t *ts, tlsf_stats_t *stats);
  */
 void tlsf_thread_reset(tlsf_thread_t *ts);
 
+#ifdef TLSF_LATENCY
+/**
+ * Copy wrapper-level latency histograms: each successful call is charged
+ * to the arena that served it, from entry until just before its final
+ * unlock, so time spent waiting on arena locks is included.  The
+ * TLSF_LAT_LOCK row holds the lock waits alone.  The per-arena pools
+ * keep their own lock-free histograms of the allocator work itself
+ * (tlsf_get_latency on ts->arenas[i].pool, under that arena's lock).
+ *
+ * @param ts    Thread-safe allocator instance
+ * @param arena Arena index, or -1 for the sum over all arenas
+ * @param lat   Output histograms
+ * @param reset Clear the copied histograms
+ * @return 0 on success, -1 on a bad argument
+ */
+int tlsf_thread_latency(tlsf_thread_t *ts,
+                        int arena,
+                        tlsf_latency_t *lat,
+                        bool reset);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""
+Fragmentation-over-time plots for TLSF allocator.
+
+Reads the CSV output of one or more 'frag -q' runs (one per allocator
+configuration) and plots largest free block, free block count and
+allocation failure rate against simulated time.  Falls back to text
+summary when matplotlib is unavailable (e.g., CI environments).
+
+Usage:
+    build/frag_default -q > a.csv && python3 scripts/frag_plot.py a.csv
+    python3 scripts/frag_plot.py build/frag_*.csv -o build/frag
+
+The output prefix (-o) controls where the PNG file is written:
+    {prefix}.png - Three stacked panels, one line per configuration
+"""
+
+import argparse
+import csv
+import sys
+from collections import defaultdict
+
+try:
+    import matplotlib
+
+    matplotlib.use("Agg")
+    import matplotlib.pyplot as plt
+
+    HAS_MATPLOTLIB = True
+except ImportError:
+    HAS_MATPLOTLIB = False
+
+
+def read_csv(paths):
+    """Read sample CSVs -> {config: [row dict, ...]} in file order."""
+    data = defaultdict(list)
+    for path in paths:
+        with open(path) as f:
+            for row in csv.DictReader(f):
+                data[row["config"]].append(
+                    {
+                        "time_s": int(row["time_s"]),
+                        "phase": row["phase"],
+                        "largest_free": int(row["largest_free"]),
+                        "free_count": int(row["free_count"]),
+                        "frag": float(row["frag"]),
+                        "fail_rate": float(row["fail_rate"]),
+                    }
+                )
+    return data
+
+
+def text_report(data):
+    """Print per-configuration summary to stdout."""
+    print(
+        f"  {'Config':<20s} {'Samples':>8s} {'MinLargest':>12s} "
+        f"{'MaxNFree':>9s} {'MaxFrag':>8s} {'MeanFail%':>10s}"
+    )
+    for config in sorted(data.keys()):
+        rows = data[config]
+        mean_fail = sum(r["fail_rate"] for r in rows) / len(rows)
+        print(
+            f"  {config:<20s} {len(rows):>8d} "
+            f"{min(r['largest_free'] for r in rows):>12d} "
+            f"{max(r['free_count'] for r in rows):>9d} "
+            f"{max(r['frag'] for r in rows):>8.4f} "
+            f"{100.0 * mean_fail:>10.3f}"
+        )
+
+
+def plot_timeline(data, output_path):
+    """Stacked panels of fragmentation metrics over simulated time."""
+    panels = [
+        ("largest_free", "Largest free (KB)", 1.0 / 1024),
+        ("free_count", "Free blocks", 1.0),
+        ("fail_rate", "Failure rate (%)", 100.0),
+    ]
+    fig, axes = plt.subplots(len(panels), 1, figsize=(10, 9), sharex=True)
+
+    for config in sorted(data.keys()):
+        rows = data[config]
+        minutes = [r["time_s"] / 60.0 for r in rows]
+        for ax, (key, _, scale) in zip(axes, panels):
+            ax.plot(minutes, [r[key] * scale for r in rows], label=config)
+
+    for ax, (_, label, _) in zip(axes, panels):
+        ax.set_ylabel(label)
+        ax.grid(True, alpha=0.3)
+    axes[0].legend(fontsize=8, loc="upper right")
+    axes[-1].set_xlabel("Simulated time (minutes)")
+
+    fig.suptitle("TLSF Fragmentation Over Time", fontsize=13, y=1.01)
+    plt.tight_layout()
+    plt.savefig(output_path, dpi=150, bbox_inches="tight")
+    print(f"  Timeline: {output_path}")
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Plot fragmentation over time from 'frag -q' output."
+    )
+    parser.add_argument("input", nargs="+", help="CSV files from 'frag -q'")
+    parser.add_argument(
+        "-o",
+        "--output",
+        default="frag",
+        help="Output file prefix (default: frag)",
+    )
+    args = parser.parse_args()
+
+    data = read_csv(args.input)
+    if not data:
+        print("No data found in input files", file=sys.stderr)
+        return 1
+
+    # Always print text summary
+    print("Fragmentation Summary:")
+    text_report(data)
+    print()
+
+    if HAS_MATPLOTLIB:
+        plot_timeline(data, f"{args.output}.png")
+    else:
+        print("Note: matplotlib not available, skipping plot generation.")
+        print("Install with: pip install matplotlib")
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
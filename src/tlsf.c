@@ -7,7 +7,15 @@
 #include <stdbool.h>
 #include <string.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define HAVE_MLOCK 1
+#endif
+
 #include "tlsf.h"
+#include "tlsf_copy.h"
+#include "tlsf_probe.h"
 
 #ifndef UNLIKELY
 #define UNLIKELY(x) __builtin_expect(!!(x), false)
@@ -15,14 +23,10 @@
 
 /* All allocation sizes and addresses are aligned. */
 #define ALIGN_SIZE ((size_t) 1 << ALIGN_SHIFT)
-#if __SIZE_WIDTH__ == 64
-#define ALIGN_SHIFT 3
-#else
-#define ALIGN_SHIFT 2
-#endif
+#define ALIGN_SHIFT TLSF_ALIGN_SHIFT
 
 /* First level (FL) and second level (SL) counts */
-#define SL_SHIFT 5
+#define SL_SHIFT TLSF_SL_SHIFT
 #define SL_COUNT (1U << SL_SHIFT)
 #define FL_MAX _TLSF_FL_MAX
 #define FL_SHIFT (SL_SHIFT + ALIGN_SHIFT)
@@ -33,13 +37,47 @@
  */
 #define BLOCK_BIT_FREE ((size_t) 1)
 #define BLOCK_BIT_PREV_FREE ((size_t) 2)
+#ifdef TLSF_PROFILE
+#define BLOCK_BIT_SAMPLED ((size_t) 4) /* Allocation is in the profile */
+#define BLOCK_BITS (BLOCK_BIT_FREE | BLOCK_BIT_PREV_FREE | BLOCK_BIT_SAMPLED)
+#else
 #define BLOCK_BITS (BLOCK_BIT_FREE | BLOCK_BIT_PREV_FREE)
+#endif
+
+/* In the compact layout the upper half of the header holds the distance
+ * back to the previous block, so the size is confined to the lower half.
+ */
+#ifdef TLSF_COMPACT
+#define BLOCK_SIZE_MASK ((size_t) UINT32_MAX)
+#define BLOCK_PREV_SHIFT 32
+#else
+#define BLOCK_SIZE_MASK (~(size_t) 0)
+#endif
+
+/* Each block is preceded by a header slot of BLOCK_OVERHEAD bytes: the
+ * header word, or ALIGN_SIZE bytes when TLSF_ALIGN_SHIFT exceeds the word
+ * size, with the header word at the end of the slot, right before the
+ * payload.  The slot keeps consecutive payloads ALIGN_SIZE apart.
+ */
+#define BLOCK_OVERHEAD _TLSF_BLOCK_OVERHEAD
+#define BLOCK_HEADER_PAD (BLOCK_OVERHEAD - sizeof(size_t))
 
-/* A free block must be large enough to store its header minus the size of the
- * prev field.
+/* A free block's payload holds its two free-list links and, in the default
+ * layout, the next block's prev field, unless that field fits in the next
+ * block's slot padding.  The compact layout keeps prev in the header.
  */
-#define BLOCK_OVERHEAD (sizeof(size_t))
-#define BLOCK_SIZE_MIN (sizeof(tlsf_block_t) - sizeof(tlsf_block_t *))
+#define BLOCK_LINKS_SIZE (sizeof(tlsf_link_t) * 2)
+#if defined(TLSF_COMPACT)
+#define BLOCK_PREV_SIZE 0
+#else
+#define BLOCK_PREV_SIZE \
+    (BLOCK_HEADER_PAD < sizeof(tlsf_block_t *) ? sizeof(tlsf_block_t *) : 0)
+#endif
+#define BLOCK_SIZE_MIN \
+    ((BLOCK_LINKS_SIZE + BLOCK_PREV_SIZE + ALIGN_SIZE - 1) & ~(ALIGN_SIZE - 1))
+
+/* The smallest stretch of pool a block occupies, slot included. */
+#define BLOCK_SPAN_MIN (BLOCK_OVERHEAD + BLOCK_SIZE_MIN)
 #define BLOCK_SIZE_MAX ((size_t) 1 << (FL_MAX - 1))
 #define BLOCK_SIZE_SMALL ((size_t) 1 << FL_SHIFT)
 
@@ -52,6 +90,54 @@
 #define TLSF_SPLIT_THRESHOLD BLOCK_SIZE_MIN
 #endif
 
+/* Good-fit depth.  When nonzero, a request above BLOCK_SIZE_SMALL first
+ * checks up to this many blocks of the bin its exact size maps to.  Only
+ * if none of them is large enough does it escalate to the next bin, as
+ * TLSF always does.  The extra work is bounded by the depth, so the
+ * allocation stays O(1).  Default: 0 (plain TLSF).
+ */
+#ifndef TLSF_GOOD_FIT
+#define TLSF_GOOD_FIT 0
+#endif
+
+/* Free blocks tlsf_aalloc() inspects for one whose payload reaches the
+ * alignment with little or no padding, before reserving align - 1 +
+ * BLOCK_SPAN_MIN extra bytes for the worst placement.  Bounds the
+ * extra work per call; each block inspected is a likely cache miss.
+ * 0 disables the probe.  Default: 2.
+ */
+#ifndef TLSF_ALIGN_PROBE
+#define TLSF_ALIGN_PROBE 2
+#endif
+
+/* Growth and shrink policy of dynamic pools.  By default a pool grows by
+ * exactly the block it is short of, and gives its free tail back every
+ * time the last block is freed, so a malloc/free pair at the end of the
+ * pool costs two tlsf_resize() calls.
+ *
+ * TLSF_GROW_PERCENT: grow the pool by at least this share of its size.
+ * TLSF_GROW_CHUNK:   round pool sizes up to a multiple of this power of
+ *                    two (page or huge-page size for mmap backends).
+ * TLSF_SHRINK_THRESHOLD: release the free tail only once it spans this
+ *                    many bytes.
+ * TLSF_SHRINK_RETAIN: bytes of free tail kept when releasing.
+ *
+ * A threshold above the retained tail plus one growth step makes the
+ * pool hold still under alternating malloc/free.  All default to 0.
+ */
+#ifndef TLSF_GROW_PERCENT
+#define TLSF_GROW_PERCENT 0
+#endif
+#ifndef TLSF_GROW_CHUNK
+#define TLSF_GROW_CHUNK 0
+#endif
+#ifndef TLSF_SHRINK_THRESHOLD
+#define TLSF_SHRINK_THRESHOLD 0
+#endif
+#ifndef TLSF_SHRINK_RETAIN
+#define TLSF_SHRINK_RETAIN 0
+#endif
+
 #ifndef ASSERT
 #ifdef TLSF_ENABLE_ASSERT
 #include <assert.h>
@@ -64,18 +150,23 @@
 /*
  * ASan shadow poisoning: teach AddressSanitizer about TLSF's internal
  * pool layout so it can detect UAF and overflow within custom pools.
- * Auto-detected; zero overhead when ASan is not active.
+ * Auto-detected; zero overhead when ASan is not active.  Shadow memory is
+ * per process, so pools shared between processes (tlsf_shm) must opt out
+ * with -DTLSF_NO_ASAN_POISON.
  */
 #ifndef __has_feature
 #define __has_feature(x) 0
 #endif
-#if __has_feature(address_sanitizer) || defined(__SANITIZE_ADDRESS__)
+#if (__has_feature(address_sanitizer) || defined(__SANITIZE_ADDRESS__)) && \
+    !defined(TLSF_NO_ASAN_POISON)
 #include <sanitizer/asan_interface.h>
 #define ASAN_POISON(addr, size) __asan_poison_memory_region((addr), (size))
 #define ASAN_UNPOISON(addr, size) __asan_unpoison_memory_region((addr), (size))
+#define NO_ASAN __attribute__((no_sanitize_address))
 #else
 #define ASAN_POISON(addr, size) ((void) (addr), (void) (size))
 #define ASAN_UNPOISON(addr, size) ((void) (addr), (void) (size))
+#define NO_ASAN
 #endif
 
 /*
@@ -93,17 +184,29 @@
 
 /*
  * Metadata bytes embedded within a free block's payload:
- *   - next_free + prev_free at the start (2 pointers)
- *   - next block's prev at the end (1 pointer)
+ *   - next_free + prev_free at the start (2 links)
+ *   - next block's prev at the end (1 pointer; none in compact layout
+ *     or when the header slot is padded)
  * Fill/poison must skip these regions to avoid corrupting TLSF
  * metadata.  For minimum-size blocks the safe region is empty.
  */
-#define BLOCK_PAYLOAD_OVERHEAD (sizeof(struct tlsf_block *) * 3)
+#define BLOCK_PAYLOAD_OVERHEAD (BLOCK_LINKS_SIZE + BLOCK_PREV_SIZE)
 
 #ifndef INLINE
 #define INLINE static inline __attribute__((always_inline))
 #endif
 
+#ifdef TLSF_HOT_LAYOUT
+_Static_assert(offsetof(tlsf_t, sl) + sizeof(tlsf_slmap_t) <=
+                   TLSF_CACHELINE_SIZE,
+               "block_null, fl and sl[0] must share the first cache line");
+_Static_assert(offsetof(tlsf_t, block) % TLSF_CACHELINE_SIZE == 0,
+               "bin array must start on a cache line");
+#endif
+
+/* Prefetch a line that is about to be written. */
+#define PREFETCH_W(addr) __builtin_prefetch((addr), 1)
+
 typedef struct tlsf_block tlsf_block_t;
 
 _Static_assert(sizeof(size_t) == 4 || sizeof(size_t) == 8,
@@ -114,14 +217,28 @@ _Static_assert(ALIGN_SIZE == BLOCK_SIZE_SMALL / SL_COUNT,
                "sizes are not properly set");
 _Static_assert(BLOCK_SIZE_MIN < BLOCK_SIZE_SMALL,
                "min allocation size is wrong");
+#if TLSF_ALIGN_SHIFT == _TLSF_ALIGN_SHIFT_MIN
+_Static_assert(sizeof(tlsf_block_t) == BLOCK_SPAN_MIN,
+               "block layout does not match minimum block size");
+#endif
+_Static_assert(BLOCK_OVERHEAD % ALIGN_SIZE == 0,
+               "header slot must keep payloads aligned");
 _Static_assert(BLOCK_SIZE_MAX == TLSF_MAX_SIZE + BLOCK_OVERHEAD,
                "max allocation size is wrong");
-_Static_assert(FL_COUNT <= 32, "index too large");
-_Static_assert(SL_COUNT <= 32, "index too large");
+_Static_assert(FL_COUNT <= sizeof(tlsf_flmap_t) * 8, "index too large");
+_Static_assert(SL_COUNT <= sizeof(tlsf_slmap_t) * 8, "index too large");
 _Static_assert(FL_COUNT == _TLSF_FL_COUNT, "invalid level configuration");
 _Static_assert(SL_COUNT == _TLSF_SL_COUNT, "invalid level configuration");
 _Static_assert(TLSF_SPLIT_THRESHOLD >= BLOCK_SIZE_MIN,
                "split threshold must be at least minimum block size");
+_Static_assert(TLSF_GOOD_FIT >= 0, "good-fit depth must not be negative");
+_Static_assert(TLSF_ALIGN_PROBE >= 0, "align probe must not be negative");
+_Static_assert(TLSF_GROW_PERCENT >= 0, "growth must not be negative");
+_Static_assert(!(TLSF_GROW_CHUNK & (TLSF_GROW_CHUNK - 1)) &&
+                   (!TLSF_GROW_CHUNK || TLSF_GROW_CHUNK >= ALIGN_SIZE),
+               "growth chunk must be a power of two of at least ALIGN_SIZE");
+_Static_assert(TLSF_SHRINK_THRESHOLD >= 0 && TLSF_SHRINK_RETAIN >= 0,
+               "shrink policy must not be negative");
 _Static_assert(_TLSF_FL_COUNT >= 1,
                "TLSF_MAX_POOL_BITS too small for this architecture");
 _Static_assert(FL_MAX < __SIZE_WIDTH__,
@@ -143,12 +260,59 @@ __attribute__((weak)) void *tlsf_resize(tlsf_t *t, size_t size)
     return NULL;
 }
 
+#ifdef TLSF_PROFILE
+/*
+ * Default (weak) profiler hooks, replaced by src/tlsf_prof.c when it is
+ * linked in.  With no profiler the countdown is parked at its maximum.
+ */
+__attribute__((weak)) bool tlsf_prof_sample(tlsf_t *t, void *ptr, size_t size)
+{
+    (void) ptr;
+    (void) size;
+    t->prof_countdown = PTRDIFF_MAX;
+    return false;
+}
+
+__attribute__((weak)) void tlsf_prof_release(tlsf_t *t, void *ptr)
+{
+    (void) t;
+    (void) ptr;
+}
+#endif
+
 INLINE uint32_t bitmap_ffs(uint32_t x)
 {
     ASSERT(x, "no set bit found");
     return (uint32_t) __builtin_ctz(x);
 }
 
+INLINE uint32_t bitmap_ffs64(uint64_t x)
+{
+    ASSERT(x, "no set bit found");
+    return (uint32_t) __builtin_ctzll((unsigned long long) x);
+}
+
+/* Bitmap scans sized to the configured level widths.  The word width is
+ * fixed at compile time, so the untaken branch folds away.
+ */
+INLINE uint32_t fl_ffs(tlsf_flmap_t x)
+{
+    return sizeof(x) > 4 ? bitmap_ffs64(x) : bitmap_ffs((uint32_t) x);
+}
+
+INLINE uint32_t sl_ffs(tlsf_slmap_t x)
+{
+    return sizeof(x) > 4 ? bitmap_ffs64(x) : bitmap_ffs((uint32_t) x);
+}
+
+#define FL_BIT(i) ((tlsf_flmap_t) 1 << (i))
+#define SL_BIT(i) ((tlsf_slmap_t) 1 << (i))
+/* Bits at positions >= i; i may equal the word width (yields 0). */
+#define FL_FROM(i)                                         \
+    ((i) >= sizeof(tlsf_flmap_t) * 8 ? (tlsf_flmap_t) 0 \
+                                     : ~(tlsf_flmap_t) 0 << (i))
+#define SL_FROM(i) (~(tlsf_slmap_t) 0 << (i))
+
 INLINE uint32_t log2floor(size_t x)
 {
     ASSERT(x > 0, "log2 of zero");
@@ -161,13 +325,13 @@ INLINE uint32_t log2floor(size_t x)
 
 INLINE size_t block_size(const tlsf_block_t *block)
 {
-    return block->header & ~BLOCK_BITS;
+    return block->header & BLOCK_SIZE_MASK & ~BLOCK_BITS;
 }
 
 INLINE void block_set_size(tlsf_block_t *block, size_t size)
 {
     ASSERT(!(size % ALIGN_SIZE), "invalid size");
-    block->header = size | (block->header & BLOCK_BITS);
+    block->header = size | (block->header & (BLOCK_BITS | ~BLOCK_SIZE_MASK));
 }
 
 INLINE bool block_is_free(const tlsf_block_t *block)
@@ -215,7 +379,7 @@ INLINE char *align_ptr(char *p, size_t align)
 
 INLINE char *block_payload(tlsf_block_t *block)
 {
-    return (char *) block + offsetof(tlsf_block_t, header) + BLOCK_OVERHEAD;
+    return (char *) block + offsetof(tlsf_block_t, header) + sizeof(size_t);
 }
 
 INLINE tlsf_block_t *to_block(void *ptr)
@@ -229,7 +393,70 @@ INLINE tlsf_block_t *to_block(void *ptr)
 INLINE tlsf_block_t *block_from_payload(void *ptr)
 {
     return to_block((char *) ptr - offsetof(tlsf_block_t, header) -
-                    BLOCK_OVERHEAD);
+                    sizeof(size_t));
+}
+
+/* Return the block whose header slot starts at hdr. */
+INLINE tlsf_block_t *block_from_header(char *hdr)
+{
+    return to_block(hdr + BLOCK_HEADER_PAD - offsetof(tlsf_block_t, header));
+}
+
+/*
+ * Free-list links.  In the default layout a link is the block pointer
+ * itself.  In the compact layout it is a 32-bit offset from t->base, with
+ * LINK_NIL standing for the block_null sentinel (which lives in tlsf_t,
+ * outside the pool).
+ */
+#ifdef TLSF_COMPACT
+#define LINK_NIL UINT32_MAX
+
+INLINE tlsf_link_t link_null(tlsf_t *t)
+{
+    (void) t;
+    return LINK_NIL;
+}
+
+INLINE tlsf_block_t *link_to_block(tlsf_t *t, tlsf_link_t link)
+{
+    return link == LINK_NIL ? &t->block_null : to_block(t->base + link);
+}
+
+INLINE tlsf_link_t block_to_link(tlsf_t *t, tlsf_block_t *block)
+{
+    return block == &t->block_null ? LINK_NIL
+                                   : (tlsf_link_t) ((char *) block - t->base);
+}
+#else
+INLINE tlsf_link_t link_null(tlsf_t *t)
+{
+    return &t->block_null;
+}
+
+INLINE tlsf_block_t *link_to_block(tlsf_t *t, tlsf_link_t link)
+{
+    (void) t;
+    return link;
+}
+
+INLINE tlsf_link_t block_to_link(tlsf_t *t, tlsf_block_t *block)
+{
+    (void) t;
+    return block;
+}
+#endif
+
+/* Zero the control structure except the bin heads.  A head is only read
+ * while its SL bitmap bit is set (insert_free_block() supplies the
+ * sentinel for an empty bin), so the heads of an empty pool can hold
+ * anything.  This skips FL_COUNT * SL_COUNT stores, most of tlsf_t.
+ */
+INLINE void control_reset(tlsf_t *t)
+{
+    const size_t bins = offsetof(tlsf_t, block);
+    const size_t tail = bins + sizeof(t->block);
+    memset(t, 0, bins);
+    memset((char *) t + tail, 0, sizeof(*t) - tail);
 }
 
 /* Poison the safe region of a free block's payload.
@@ -244,7 +471,7 @@ INLINE void block_poison_free(tlsf_block_t *block)
     size_t bsize = block_size(block);
     ASAN_UNPOISON(block_payload(block), bsize);
     if (bsize > BLOCK_PAYLOAD_OVERHEAD) {
-        char *safe = block_payload(block) + sizeof(tlsf_block_t *) * 2;
+        char *safe = block_payload(block) + BLOCK_LINKS_SIZE;
         size_t safe_len = bsize - BLOCK_PAYLOAD_OVERHEAD;
         POISON_FILL(safe, 0xFF, safe_len);
         ASAN_POISON(safe, safe_len);
@@ -252,32 +479,44 @@ INLINE void block_poison_free(tlsf_block_t *block)
 }
 
 /* Return location of previous block. */
-INLINE tlsf_block_t *block_prev(const tlsf_block_t *block)
+INLINE tlsf_block_t *block_prev(tlsf_block_t *block)
 {
     ASSERT(block_is_prev_free(block), "previous block must be free");
+#ifdef TLSF_COMPACT
+    return to_block((char *) block - (block->header >> BLOCK_PREV_SHIFT));
+#else
     return block->prev;
+#endif
 }
 
 /* Return location of next existing block. */
 INLINE tlsf_block_t *block_next(tlsf_block_t *block)
 {
     tlsf_block_t *next =
-        to_block(block_payload(block) + block_size(block) - BLOCK_OVERHEAD);
+        block_from_header(block_payload(block) + block_size(block));
     ASSERT(block_size(block), "block is last");
     return next;
 }
 
-/* Link a new block with its neighbor, return the neighbor. */
+/* Link a new block with its neighbor, return the neighbor.
+ * In the compact layout this writes the neighbor's header, so callers
+ * that assign a header wholesale must do so before linking.
+ */
 INLINE tlsf_block_t *block_link_next(tlsf_block_t *block)
 {
     tlsf_block_t *next = block_next(block);
+#ifdef TLSF_COMPACT
+    size_t dist = (size_t) ((char *) next - (char *) block);
+    next->header = (next->header & BLOCK_SIZE_MASK) | dist << BLOCK_PREV_SHIFT;
+#else
     next->prev = block;
+#endif
     return next;
 }
 
 INLINE bool block_can_split(tlsf_block_t *block, size_t size)
 {
-    return block_size(block) >= sizeof(tlsf_block_t) + size;
+    return block_size(block) >= BLOCK_SPAN_MIN + size;
 }
 
 /* When trimming, require the remainder to be at least TLSF_SPLIT_THRESHOLD
@@ -379,26 +618,26 @@ INLINE tlsf_block_t *block_find_suitable(tlsf_t *t, uint32_t *fl, uint32_t *sl)
     ASSERT(*sl < SL_COUNT, "wrong second level");
 
     /* Search for a block in the list associated with the given fl/sl index. */
-    uint32_t sl_map = t->sl[*fl] & (~0U << *sl);
+    tlsf_slmap_t sl_map = t->sl[*fl] & SL_FROM(*sl);
     if (!sl_map) {
         /* No block exists. Search in the next largest first-level list. */
-        uint32_t fl_map = t->fl & ((*fl + 1 >= 32) ? 0U : (~0U << (*fl + 1)));
+        tlsf_flmap_t fl_map = t->fl & FL_FROM(*fl + 1);
 
         /* No free blocks available, memory has been exhausted. */
         if (UNLIKELY(!fl_map))
             return NULL;
 
-        *fl = bitmap_ffs(fl_map);
+        *fl = fl_ffs(fl_map);
         ASSERT(*fl < FL_COUNT, "wrong first level");
 
         sl_map = t->sl[*fl];
         ASSERT(sl_map, "second level bitmap is null");
     }
 
-    *sl = bitmap_ffs(sl_map);
+    *sl = sl_ffs(sl_map);
     ASSERT(*sl < SL_COUNT, "wrong second level");
 
-    return t->block[*fl][*sl];
+    return link_to_block(t, t->block[*fl][*sl]);
 }
 
 /* Remove a free block from the free list.
@@ -413,22 +652,22 @@ INLINE void remove_free_block(tlsf_t *t,
     ASSERT(fl < FL_COUNT, "wrong first level");
     ASSERT(sl < SL_COUNT, "wrong second level");
 
-    tlsf_block_t *prev = block->prev_free;
-    tlsf_block_t *next = block->next_free;
-    next->prev_free = prev;
-    prev->next_free = next;
+    tlsf_block_t *prev = link_to_block(t, block->prev_free);
+    tlsf_block_t *next = link_to_block(t, block->next_free);
+    next->prev_free = block->prev_free;
+    prev->next_free = block->next_free;
 
     /* If this block is the head of the free list, set new head. */
-    if (t->block[fl][sl] == block) {
-        t->block[fl][sl] = next;
+    if (t->block[fl][sl] == block_to_link(t, block)) {
+        t->block[fl][sl] = block->next_free;
 
         /* If the new head is the sentinel, the bin is empty. */
         if (next == &t->block_null) {
-            t->sl[fl] &= ~(1U << sl);
+            t->sl[fl] &= ~SL_BIT(sl);
 
             /* If the second bitmap is now empty, clear the fl bitmap. */
             if (!t->sl[fl])
-                t->fl &= ~(1U << fl);
+                t->fl &= ~FL_BIT(fl);
         }
     }
 }
@@ -442,14 +681,18 @@ INLINE void insert_free_block(tlsf_t *t,
                               uint32_t fl,
                               uint32_t sl)
 {
-    tlsf_block_t *current = t->block[fl][sl];
+    /* The head of an empty bin is stale; the list it starts is empty. */
+    tlsf_link_t head =
+        (t->sl[fl] & SL_BIT(sl)) ? t->block[fl][sl] : link_null(t);
+    tlsf_block_t *current = link_to_block(t, head);
+    tlsf_link_t link = block_to_link(t, block);
     ASSERT(block, "cannot insert a null entry into the free list");
-    block->next_free = current;
-    block->prev_free = &t->block_null;
-    current->prev_free = block;
-    t->block[fl][sl] = block;
-    t->fl |= 1U << fl;
-    t->sl[fl] |= 1U << sl;
+    block->next_free = head;
+    block->prev_free = link_null(t);
+    current->prev_free = link;
+    t->block[fl][sl] = link;
+    t->fl |= FL_BIT(fl);
+    t->sl[fl] |= SL_BIT(sl);
 }
 
 /* Remove a given block from the free list. */
@@ -471,7 +714,7 @@ INLINE void block_insert(tlsf_t *t, tlsf_block_t *block)
 /* Split a block into two, the second of which is free. */
 INLINE tlsf_block_t *block_split(tlsf_block_t *block, size_t size)
 {
-    tlsf_block_t *rest = to_block(block_payload(block) + size - BLOCK_OVERHEAD);
+    tlsf_block_t *rest = block_from_header(block_payload(block) + size);
     size_t rest_size = block_size(block) - (size + BLOCK_OVERHEAD);
     ASSERT(block_size(block) == rest_size + size + BLOCK_OVERHEAD,
            "rest block size is wrong");
@@ -572,6 +815,76 @@ INLINE void *block_use(tlsf_t *t, tlsf_block_t *block, size_t size)
     return block_payload(block);
 }
 
+#ifdef TLSF_PROFILE
+/* Charge an allocation to the sampling countdown.  The profiler is only
+ * called when the countdown runs out.
+ */
+INLINE void *prof_alloc(tlsf_t *t, void *mem, size_t size)
+{
+    if (mem && UNLIKELY((t->prof_countdown -= (ptrdiff_t) size) < 0) &&
+        tlsf_prof_sample(t, mem, size))
+        block_from_payload(mem)->header |= BLOCK_BIT_SAMPLED;
+    return mem;
+}
+
+/* Take a block out of the profile before it is freed or resized.
+ * Returns whether it was sampled.
+ */
+INLINE bool prof_release(tlsf_t *t, tlsf_block_t *block)
+{
+    if (UNLIKELY(block->header & BLOCK_BIT_SAMPLED)) {
+        block->header &= ~BLOCK_BIT_SAMPLED;
+        tlsf_prof_release(t, block_payload(block));
+        return true;
+    }
+    return false;
+}
+
+/* Profile a block resized in place to @size bytes.  A block that was
+ * sampled is sampled again at its new size; any other is charged only
+ * the @grown bytes, so repeated reallocs do not inflate the rate.
+ */
+INLINE void *prof_resize(tlsf_t *t,
+                         void *mem,
+                         size_t size,
+                         size_t grown,
+                         bool sampled)
+{
+    if ((sampled ||
+         UNLIKELY((t->prof_countdown -= (ptrdiff_t) grown) < 0)) &&
+        tlsf_prof_sample(t, mem, size))
+        block_from_payload(mem)->header |= BLOCK_BIT_SAMPLED;
+    return mem;
+}
+#else
+INLINE void *prof_alloc(tlsf_t *t, void *mem, size_t size)
+{
+    (void) t;
+    (void) size;
+    return mem;
+}
+
+INLINE bool prof_release(tlsf_t *t, tlsf_block_t *block)
+{
+    (void) t;
+    (void) block;
+    return false;
+}
+
+INLINE void *prof_resize(tlsf_t *t,
+                         void *mem,
+                         size_t size,
+                         size_t grown,
+                         bool sampled)
+{
+    (void) t;
+    (void) size;
+    (void) grown;
+    (void) sampled;
+    return mem;
+}
+#endif
+
 INLINE void check_sentinel(tlsf_block_t *block)
 {
     (void) block;
@@ -579,23 +892,34 @@ INLINE void check_sentinel(tlsf_block_t *block)
     ASSERT(!block_is_free(block), "sentinel block should not be free");
 }
 
+/* Pool size to ask tlsf_resize() for when req_size is the least that
+ * will do, per the growth policy.  Falls back to req_size if the policy
+ * would exceed the addressable range.
+ */
+INLINE size_t arena_grow_size(const tlsf_t *t, size_t req_size)
+{
+    size_t want = req_size;
+#if TLSF_GROW_PERCENT > 0
+    size_t geometric = t->size + t->size / 100 * TLSF_GROW_PERCENT;
+    if (geometric > want)
+        want = align_up(geometric, ALIGN_SIZE);
+#else
+    (void) t;
+#endif
+#if TLSF_GROW_CHUNK > 0
+    want = align_up(want, TLSF_GROW_CHUNK);
+#endif
+    return want <= (size_t) 1 << FL_MAX ? want : req_size;
+}
+
 static bool arena_grow(tlsf_t *t, size_t size)
 {
     /* Static pools cannot grow. */
     if (t->arena)
         return false;
 
-    /* First use of a dynamic pool: point all empty-bin pointers at the
-     * sentinel so that insert/remove can write unconditionally.
-     */
-    if (!t->size) {
-        for (uint32_t i = 0; i < FL_COUNT; i++)
-            for (uint32_t j = 0; j < SL_COUNT; j++)
-                t->block[i][j] = &t->block_null;
-    }
-
-    size_t req_size =
-        (t->size ? t->size + BLOCK_OVERHEAD : 2 * BLOCK_OVERHEAD) + size;
+    const size_t base = t->size ? t->size + BLOCK_OVERHEAD : 2 * BLOCK_OVERHEAD;
+    size_t req_size = base + size;
 
     /* Pool cannot exceed the maximum addressable range for the configured
      * first-level index.  With reduced TLSF_MAX_POOL_BITS, this prevents
@@ -604,28 +928,42 @@ static bool arena_grow(tlsf_t *t, size_t size)
     if (UNLIKELY(req_size > (size_t) 1 << FL_MAX))
         return false;
 
-    void *addr = tlsf_resize(t, req_size);
+    /* Grow by more than asked if the policy says so; a backend that cannot
+     * provide the extra still gets the exact request.
+     */
+    size_t want = arena_grow_size(t, req_size);
+    void *addr = tlsf_resize(t, want);
+    if (addr)
+        req_size = want;
+    else if (want != req_size)
+        addr = tlsf_resize(t, req_size);
     if (!addr)
         return false;
+    size = req_size - base;
     ASSERT((size_t) addr % ALIGN_SIZE == 0, "wrong heap alignment address");
 
     /* Clear stale ASan shadow in the growth region: prior arena_shrink
      * cycles may have left poisoned shadow bytes that were never cleared.
      */
     ASAN_UNPOISON((char *) addr + t->size, req_size - t->size);
-    tlsf_block_t *block =
-        to_block(t->size ? (char *) addr + t->size - 2 * BLOCK_OVERHEAD
-                         : (char *) addr - BLOCK_OVERHEAD);
-    if (!t->size)
+    tlsf_block_t *block = block_from_header(
+        t->size ? (char *) addr + t->size - BLOCK_OVERHEAD : (char *) addr);
+    if (!t->size) {
         block->header = 0;
+#ifdef TLSF_COMPACT
+        t->base = (char *) addr;
+#endif
+    }
     check_sentinel(block);
     block->header |= size | BLOCK_BIT_FREE;
     block = block_merge_prev(t, block);
     block_insert(t, block);
-    tlsf_block_t *sentinel = block_link_next(block);
+    tlsf_block_t *sentinel = block_next(block);
     sentinel->header = BLOCK_BIT_PREV_FREE;
+    block_link_next(block);
     t->size = req_size;
     check_sentinel(sentinel);
+    TLSF_PROBE4(tlsf, grow, t, addr, size, req_size);
 
     block_poison_free(block);
     return true;
@@ -695,8 +1033,8 @@ static size_t arena_append_pool(tlsf_t *t, void *mem, size_t size)
     t->size = new_total_size;
 
     /* Find the current sentinel block */
-    tlsf_block_t *old_sentinel =
-        to_block((char *) current_pool_start + old_size - 2 * BLOCK_OVERHEAD);
+    tlsf_block_t *old_sentinel = block_from_header(
+        (char *) current_pool_start + old_size - BLOCK_OVERHEAD);
     check_sentinel(old_sentinel);
 
     /* Check if the block before the sentinel is free */
@@ -746,57 +1084,244 @@ static size_t arena_append_pool(tlsf_t *t, void *mem, size_t size)
     block_insert(t, new_free_block);
 
     /* Create a new sentinel at the end */
-    tlsf_block_t *new_sentinel = block_link_next(new_free_block);
+    tlsf_block_t *new_sentinel = block_next(new_free_block);
     new_sentinel->header = BLOCK_BIT_PREV_FREE;
+    block_link_next(new_free_block);
     check_sentinel(new_sentinel);
 
     block_poison_free(new_free_block);
     return aligned_size;
 }
 
+/* Release the free last block of a dynamic pool to tlsf_resize(), or as
+ * much of it as the shrink policy allows.
+ */
 static void arena_shrink(tlsf_t *t, tlsf_block_t *block)
 {
     check_sentinel(block_next(block));
     size_t size = block_size(block);
+#if TLSF_SHRINK_THRESHOLD > 0
+    if (size < TLSF_SHRINK_THRESHOLD) {
+        block_insert(t, block);
+        return;
+    }
+#endif
+
+    /* Keep the head of the tail as a free block; the rest becomes the
+     * released space and, at its start, the new sentinel.
+     */
+    tlsf_block_t *kept = NULL;
+#if TLSF_SHRINK_RETAIN > 0
+    const size_t keep = adjust_size(TLSF_SHRINK_RETAIN, ALIGN_SIZE);
+    if (!block_can_split(block, keep)) {
+        block_insert(t, block);
+        return;
+    }
+    ASAN_UNPOISON(block_payload(block), size);
+    kept = block;
+    block = block_split(kept, keep);
+    block_insert(t, kept);
+    block_poison_free(kept);
+    size = block_size(block);
+#endif
+
     ASSERT(t->size + BLOCK_OVERHEAD >= size, "invalid heap size before shrink");
     t->size = t->size - size - BLOCK_OVERHEAD;
     if (t->size == BLOCK_OVERHEAD)
         t->size = 0;
+    TLSF_PROBE3(tlsf, shrink, t, size, t->size);
     tlsf_resize(t, t->size);
     if (t->size) {
-        block->header = 0;
+        block->header = kept ? BLOCK_BIT_PREV_FREE : 0;
+        if (kept)
+            block_link_next(kept);
         check_sentinel(block);
     }
 }
 
-INLINE tlsf_block_t *block_find_free(tlsf_t *t, size_t *size)
+#if TLSF_GOOD_FIT > 0
+/* Look for a block of at least size bytes among the first TLSF_GOOD_FIT
+ * blocks of the bin that size maps to.  round_block_size() skips this
+ * bin because not every block in it fits.  Bins below BLOCK_SIZE_SMALL
+ * hold a single size and are never skipped.
+ */
+INLINE tlsf_block_t *block_find_good_fit(tlsf_t *t,
+                                         size_t size,
+                                         uint32_t *fl,
+                                         uint32_t *sl)
+{
+    if (size < BLOCK_SIZE_SMALL)
+        return NULL;
+    mapping(size, fl, sl);
+    if (!(t->sl[*fl] & SL_BIT(*sl)))
+        return NULL;
+
+    tlsf_block_t *block = link_to_block(t, t->block[*fl][*sl]);
+    for (unsigned i = 0; i < TLSF_GOOD_FIT && block != &t->block_null; i++) {
+        if (block_size(block) >= size)
+            return block;
+        block = link_to_block(t, block->next_free);
+    }
+    return NULL;
+}
+#endif
+
+/* Take a free block of at least *size bytes.  *fl and *sl are set to the
+ * bin searched from, or on success the bin the block came from.
+ *
+ * *size is rounded up to the bin boundary that the search starts from,
+ * and the caller trims the block to that size, not to the minimum of the
+ * bin where the block was found.  A 1 KB request served from a 4 MB block
+ * then takes about 1 KB, not 4 MB.  The trimmed size is a bin boundary,
+ * so freeing the block puts it in the first bin that a request of the
+ * same size searches, where it is found again in O(1).
+ *
+ * With TLSF_GOOD_FIT, *size is left unrounded: the block is trimmed to
+ * the request, and when freed it lands in the bin that good-fit checks
+ * first for a request of the same size.
+ */
+INLINE tlsf_block_t *block_find_free(tlsf_t *t,
+                                     size_t *size,
+                                     uint32_t *fl,
+                                     uint32_t *sl)
 {
+#if TLSF_GOOD_FIT > 0
+    tlsf_block_t *fit = block_find_good_fit(t, *size, fl, sl);
+    if (fit) {
+        remove_free_block(t, fit, *fl, *sl);
+        return fit;
+    }
+    const size_t req = *size;
+#endif
     *size = round_block_size(*size);
-    uint32_t fl, sl;
-    mapping(*size, &fl, &sl);
-    tlsf_block_t *block = block_find_suitable(t, &fl, &sl);
+    mapping(*size, fl, sl);
+    tlsf_block_t *block = block_find_suitable(t, fl, sl);
     if (UNLIKELY(!block)) {
         if (!arena_grow(t, *size))
             return NULL;
-        block = block_find_suitable(t, &fl, &sl);
+        block = block_find_suitable(t, fl, sl);
         ASSERT(block, "no block found");
     }
 
-    /* Update size to match the FL/SL bin that was actually used.
-     * This ensures that when the block is freed, it will be placed in the same
-     * bin it was allocated from.
-     */
-    *size = mapping_size(fl, sl);
     ASSERT(block_size(block) >= *size, "insufficient block size");
-    remove_free_block(t, block, fl, sl);
+    remove_free_block(t, block, *fl, *sl);
+#if TLSF_GOOD_FIT > 0
+    *size = req;
+#endif
     return block;
 }
 
-void *tlsf_malloc(tlsf_t *t, size_t size)
+/* Padding in front of a free block's payload that aligns the allocation:
+ * zero when the payload is aligned already, otherwise enough room to
+ * split the padding off as a free block of its own.
+ */
+INLINE size_t align_gap(tlsf_block_t *block, size_t align)
+{
+    char *payload = block_payload(block);
+    if (!((uintptr_t) payload & (align - 1)))
+        return 0;
+    return (size_t) (align_ptr(payload + BLOCK_SPAN_MIN, align) - payload);
+}
+
+/* Take a free block holding size bytes at an align boundary, looking at
+ * no more than TLSF_ALIGN_PROBE blocks, from the bin of size upward.  A
+ * block found here only needs its own padding, not the worst case, so a
+ * page-aligned page fits in a free page-aligned page.  *gap is set to
+ * the padding, *fl and *sl to the bin.  NULL if no inspected block fits;
+ * the pool is not grown.
+ */
+INLINE tlsf_block_t *block_find_aligned(tlsf_t *t,
+                                        size_t align,
+                                        size_t size,
+                                        size_t *gap,
+                                        uint32_t *fl,
+                                        uint32_t *sl)
+{
+    mapping(round_block_size(size), fl, sl);
+    tlsf_slmap_t sl_map = t->sl[*fl] & SL_FROM(*sl);
+    unsigned probed = 0;
+
+    for (;;) {
+        if (!sl_map) {
+            tlsf_flmap_t fl_map = t->fl & FL_FROM(*fl + 1);
+            if (!fl_map)
+                return NULL;
+            *fl = fl_ffs(fl_map);
+            sl_map = t->sl[*fl];
+        }
+        *sl = sl_ffs(sl_map);
+        sl_map &= sl_map - 1;
+
+        for (tlsf_block_t *block = link_to_block(t, t->block[*fl][*sl]);
+             block != &t->block_null;
+             block = link_to_block(t, block->next_free)) {
+            if (probed++ == TLSF_ALIGN_PROBE)
+                return NULL;
+            *gap = align_gap(block, align);
+            if (block_size(block) >= *gap + size &&
+                (!*gap || block_can_split(block, *gap))) {
+                remove_free_block(t, block, *fl, *sl);
+                return block;
+            }
+        }
+    }
+}
+
+/* Start the cache misses of merging a freed block: both neighbours'
+ * headers.  Independent of each other, they overlap instead of being
+ * discovered one after the other along the merge path.  Only hints:
+ * a stale address (a neighbour freed earlier in a batch) costs nothing.
+ */
+INLINE void free_prefetch_neighbours(tlsf_block_t *block)
+{
+    PREFETCH_W(block_payload(block) + block_size(block));
+    if (block_is_prev_free(block))
+        PREFETCH_W(&block_prev(block)->header);
+}
+
+/* As above, plus the bin the block lands in when neither neighbour is
+ * free.  The bin lookup costs a mapping(), so only tlsf_free_batch(),
+ * which runs it ahead of time, pays for it.
+ */
+INLINE void free_prefetch(tlsf_t *t, tlsf_block_t *block)
+{
+    free_prefetch_neighbours(block);
+    uint32_t fl, sl;
+    mapping(block_size(block), &fl, &sl);
+    PREFETCH_W(&t->block[fl][sl]);
+}
+
+/* Pointers ahead of the one being freed whose misses tlsf_free_batch()
+ * keeps in flight.  Headers are fetched 2 * TLSF_FREE_AHEAD ahead so
+ * that free_prefetch() can read them without stalling.
+ */
+#ifndef TLSF_FREE_AHEAD
+#define TLSF_FREE_AHEAD 4
+#endif
+
+/*
+ * With TLSF_LATENCY the public entry points further down time these
+ * implementations; otherwise the implementations are the entry points.
+ * Internal calls (realloc relocating, small-alignment aalloc) always go
+ * to the implementations, so each public call is recorded once.
+ */
+#ifdef TLSF_LATENCY
+#define POOL_API static
+#else
+#define POOL_API
+#define pool_malloc tlsf_malloc
+#define pool_aalloc tlsf_aalloc
+#define pool_realloc tlsf_realloc
+#define pool_try_expand tlsf_try_expand
+#define pool_free tlsf_free
+#endif
+
+POOL_API void *pool_malloc(tlsf_t *t, size_t size)
 {
     size = adjust_size(size, ALIGN_SIZE);
     if (UNLIKELY(size > TLSF_MAX_SIZE))
         return NULL;
+    const size_t req = size;
 
     /* Fast path: small sizes (FL=0) use linear SL mapping directly.
      * FL=0 bins are spaced at ALIGN_SIZE granularity, so we can skip
@@ -804,60 +1329,91 @@ void *tlsf_malloc(tlsf_t *t, size_t size)
      */
     if (size < BLOCK_SIZE_SMALL) {
         uint32_t sl = (uint32_t) (size >> ALIGN_SHIFT);
-        uint32_t sl_map = t->sl[0] & (~0U << sl);
+        tlsf_slmap_t sl_map = t->sl[0] & SL_FROM(sl);
         if (sl_map) {
-            uint32_t found_sl = bitmap_ffs(sl_map);
-            /* Use the bin's minimum size so mapping(block_size) returns
-             * the same bin on free.
+            uint32_t found_sl = sl_ffs(sl_map);
+            /* FL=0 bins hold a single size each, so size is already a bin
+             * boundary; a larger block found here is trimmed back to it.
              */
-            size = (size_t) found_sl << ALIGN_SHIFT;
-            tlsf_block_t *block = t->block[0][found_sl];
+            tlsf_block_t *block = link_to_block(t, t->block[0][found_sl]);
             remove_free_block(t, block, 0, found_sl);
-            return block_use(t, block, size);
+            void *mem = prof_alloc(t, block_use(t, block, size), req);
+            TLSF_PROBE5(tlsf, malloc, t, mem, req, 0, found_sl);
+            return mem;
         }
         /* Fall through: search larger FL classes via generic path */
     }
 
-    tlsf_block_t *block = block_find_free(t, &size);
-    if (UNLIKELY(!block))
+    uint32_t fl, sl;
+    tlsf_block_t *block = block_find_free(t, &size, &fl, &sl);
+    if (UNLIKELY(!block)) {
+        TLSF_PROBE5(tlsf, malloc, t, NULL, req, fl, sl);
         return NULL;
-    return block_use(t, block, size);
+    }
+    void *mem = prof_alloc(t, block_use(t, block, size), req);
+    TLSF_PROBE5(tlsf, malloc, t, mem, req, fl, sl);
+    return mem;
 }
 
-void *tlsf_aalloc(tlsf_t *t, size_t align, size_t size)
+POOL_API void *pool_aalloc(tlsf_t *t, size_t align, size_t size)
 {
     size_t adjust = adjust_size(size, ALIGN_SIZE);
 
     if (UNLIKELY(
             !align || (align & (align - 1)) /* align must be power of two */
-            || align > TLSF_MAX_SIZE || sizeof(tlsf_block_t) > TLSF_MAX_SIZE ||
+            || align > TLSF_MAX_SIZE || BLOCK_SPAN_MIN > TLSF_MAX_SIZE ||
             adjust > TLSF_MAX_SIZE - align -
-                         sizeof(tlsf_block_t) /* size is too large */))
+                         BLOCK_SPAN_MIN /* size is too large */))
         return NULL;
 
     if (align <= ALIGN_SIZE)
-        return tlsf_malloc(t, size);
+        return pool_malloc(t, size);
+
+    uint32_t fl, sl;
+    char *mem;
+#if TLSF_ALIGN_PROBE > 0
+    size_t gap;
+    tlsf_block_t *fit = block_find_aligned(t, align, adjust, &gap, &fl, &sl);
+    if (fit) {
+        ASAN_UNPOISON(block_payload(fit), block_size(fit));
+        if (gap)
+            fit = block_ltrim_free(t, fit, gap);
+        mem = (char *) prof_alloc(t, block_use(t, fit, adjust), adjust);
+        TLSF_PROBE6(tlsf, aalloc, t, mem, align, adjust, fl, sl);
+        return mem;
+    }
+#endif
 
+    /* Reserve room for the worst placement: any block in the bins
+     * searched then fits.
+     */
     size_t asize =
-        adjust_size(adjust + align - 1 + sizeof(tlsf_block_t), align);
-    tlsf_block_t *block = block_find_free(t, &asize);
-    if (UNLIKELY(!block))
+        adjust_size(adjust + align - 1 + BLOCK_SPAN_MIN, align);
+    tlsf_block_t *block = block_find_free(t, &asize, &fl, &sl);
+    if (UNLIKELY(!block)) {
+        TLSF_PROBE6(tlsf, aalloc, t, NULL, align, adjust, fl, sl);
         return NULL;
+    }
 
     ASAN_UNPOISON(block_payload(block), block_size(block));
 
-    char *mem = align_ptr(block_payload(block) + sizeof(tlsf_block_t), align);
+    mem = align_ptr(block_payload(block) + BLOCK_SPAN_MIN, align);
     block = block_ltrim_free(t, block, (size_t) (mem - block_payload(block)));
-    return block_use(t, block, adjust);
+    mem = (char *) prof_alloc(t, block_use(t, block, adjust), adjust);
+    TLSF_PROBE6(tlsf, aalloc, t, mem, align, adjust, fl, sl);
+    return mem;
 }
 
-void tlsf_free(tlsf_t *t, void *mem)
+POOL_API void pool_free(tlsf_t *t, void *mem)
 {
     if (UNLIKELY(!mem))
         return;
 
     tlsf_block_t *block = block_from_payload(mem);
     ASSERT(!block_is_free(block), "block already marked as free");
+    free_prefetch_neighbours(block);
+    TLSF_PROBE3(tlsf, free, t, mem, block_size(block));
+    prof_release(t, block);
 
     block_set_free(block, true);
     block = block_merge_prev(t, block);
@@ -880,18 +1436,41 @@ size_t tlsf_usable_size(void *ptr)
     return block_size(block);
 }
 
-void *tlsf_realloc(tlsf_t *t, void *mem, size_t size)
+/* Forward expansion: absorb the free block that follows a used block.
+ * No data moves; the caller trims the result back to the size it needs.
+ */
+INLINE void block_grow_next(tlsf_t *t, tlsf_block_t *block)
+{
+    block_merge_next(t, block);
+    ASAN_UNPOISON(block_payload(block), block_size(block));
+    block_set_prev_free(block_next(block), false);
+}
+
+/* Move a block's contents to a new allocation of @size bytes. */
+static void *block_relocate(tlsf_t *t, void *mem, size_t avail, size_t size)
+{
+    void *dst = pool_malloc(t, size);
+    if (dst) {
+        tlsf_copy(dst, mem, avail);
+        pool_free(t, mem);
+    }
+    TLSF_PROBE4(tlsf, realloc, t, mem, dst, size);
+    return dst;
+}
+
+POOL_API void *pool_realloc(tlsf_t *t, void *mem, size_t size)
 {
     /* Zero-size requests are treated as free. */
     if (UNLIKELY(mem && !size)) {
-        tlsf_free(t, mem);
+        pool_free(t, mem);
         return NULL;
     }
 
     /* Null-pointer requests are treated as malloc. */
     if (UNLIKELY(!mem))
-        return tlsf_malloc(t, size);
+        return pool_malloc(t, size);
 
+    void *const old = mem;
     tlsf_block_t *block = block_from_payload(mem);
     size_t avail = block_size(block);
     size = adjust_size(size, ALIGN_SIZE);
@@ -900,6 +1479,11 @@ void *tlsf_realloc(tlsf_t *t, void *mem, size_t size)
 
     ASSERT(!block_is_free(block), "block already marked as free");
 
+    /* Relocation is a malloc plus a free, which profile themselves; the
+     * block leaves the profile here only once it is resized in place.
+     */
+    bool sampled = false;
+
     /* Do we need to expand? */
     if (size > avail) {
         tlsf_block_t *next = block_next(block);
@@ -908,11 +1492,10 @@ void *tlsf_realloc(tlsf_t *t, void *mem, size_t size)
 
         /* Try forward expansion first (no data movement required). */
         if (next_free && size <= avail + next_size) {
-            block_merge_next(t, block);
-            ASAN_UNPOISON(block_payload(block), block_size(block));
-            block_set_prev_free(block_next(block), false);
+            sampled = prof_release(t, block);
+            block_grow_next(t, block);
         }
-        /* Try backward expansion (requires memmove). */
+        /* Try backward expansion (requires a move). */
         else if (block_is_prev_free(block)) {
             tlsf_block_t *prev = block_prev(block);
             size_t prev_size = block_size(prev);
@@ -923,13 +1506,15 @@ void *tlsf_realloc(tlsf_t *t, void *mem, size_t size)
                 combined += next_size;
 
             if (size <= combined) {
+                sampled = prof_release(t, block);
+
                 /* Remove prev from free list. */
                 block_remove(t, prev);
 
                 ASAN_UNPOISON(block_payload(prev), prev_size);
 
                 /* Move data to prev's payload area (regions may overlap). */
-                memmove(block_payload(prev), mem, avail);
+                tlsf_copy(block_payload(prev), mem, avail);
 
                 /* Merge prev + current: update size, preserve prev's prev_free
                  * bit. Result is a used block (not free).
@@ -954,29 +1539,211 @@ void *tlsf_realloc(tlsf_t *t, void *mem, size_t size)
                 mem = block_payload(block);
             } else {
                 /* Combined space still insufficient, must relocate. */
-                void *dst = tlsf_malloc(t, size);
-                if (dst) {
-                    memcpy(dst, mem, avail);
-                    tlsf_free(t, mem);
-                }
-                return dst;
+                return block_relocate(t, mem, avail, size);
             }
         } else {
             /* No in-place expansion possible, must relocate. */
-            void *dst = tlsf_malloc(t, size);
-            if (dst) {
-                memcpy(dst, mem, avail);
-                tlsf_free(t, mem);
-            }
-            return dst;
+            return block_relocate(t, mem, avail, size);
         }
+    } else {
+        sampled = prof_release(t, block);
     }
 
     /* Trim the resulting block and return the pointer. */
     block_rtrim_used(t, block, size);
+    TLSF_PROBE4(tlsf, realloc, t, old, mem, size);
+    return prof_resize(t, mem, size, size > avail ? size - avail : 0, sampled);
+}
+
+POOL_API size_t pool_try_expand(tlsf_t *t,
+                                void *mem,
+                                size_t min,
+                                size_t preferred)
+{
+    if (UNLIKELY(!mem))
+        return 0;
+
+    tlsf_block_t *block = block_from_payload(mem);
+    ASSERT(!block_is_free(block), "block already marked as free");
+    size_t avail = block_size(block);
+
+    min = adjust_size(min, ALIGN_SIZE);
+    if (UNLIKELY(min > TLSF_MAX_SIZE))
+        return 0;
+    if (preferred > TLSF_MAX_SIZE)
+        preferred = TLSF_MAX_SIZE;
+    preferred = adjust_size(preferred, ALIGN_SIZE);
+    if (preferred < min)
+        preferred = min;
+    if (preferred <= avail)
+        return avail;
+
+    /* Only the next physical block is considered: growing backwards would
+     * move the payload, which is what the caller is trying to avoid.
+     */
+    tlsf_block_t *next = block_next(block);
+    size_t total =
+        block_is_free(next) ? avail + block_size(next) + BLOCK_OVERHEAD : 0;
+    if (total < min)
+        return min <= avail ? avail : 0;
+
+    bool sampled = prof_release(t, block);
+    block_grow_next(t, block);
+    block_rtrim_used(t, block, preferred < total ? preferred : total);
+    size_t grown = block_size(block) - avail;
+    avail = block_size(block);
+    TLSF_PROBE4(tlsf, realloc, t, mem, mem, avail);
+    prof_resize(t, mem, avail, grown, sampled);
+    return avail;
+}
+
+void *tlsf_malloc_usable(tlsf_t *t, size_t size, size_t *usable)
+{
+    void *mem = tlsf_malloc(t, size);
+    if (usable)
+        *usable = mem ? block_size(block_from_payload(mem)) : 0;
     return mem;
 }
 
+#ifdef TLSF_LATENCY
+#define LAT_TIMED(t, op, call)                                          \
+    do {                                                                \
+        uint64_t lat_start = TLSF_LATENCY_TICK();                       \
+        call;                                                           \
+        tlsf_latency_record(&(t)->latency, (op),                        \
+                            TLSF_LATENCY_TICK() - lat_start);           \
+    } while (0)
+
+void *tlsf_malloc(tlsf_t *t, size_t size)
+{
+    void *mem;
+    LAT_TIMED(t, TLSF_LAT_MALLOC, mem = pool_malloc(t, size));
+    return mem;
+}
+
+void *tlsf_aalloc(tlsf_t *t, size_t align, size_t size)
+{
+    void *mem;
+    LAT_TIMED(t, TLSF_LAT_AALLOC, mem = pool_aalloc(t, align, size));
+    return mem;
+}
+
+void tlsf_free(tlsf_t *t, void *mem)
+{
+    if (UNLIKELY(!mem))
+        return;
+    LAT_TIMED(t, TLSF_LAT_FREE, pool_free(t, mem));
+}
+
+void *tlsf_realloc(tlsf_t *t, void *mem, size_t size)
+{
+    LAT_TIMED(t, TLSF_LAT_REALLOC, mem = pool_realloc(t, mem, size));
+    return mem;
+}
+
+size_t tlsf_try_expand(tlsf_t *t, void *mem, size_t min, size_t preferred)
+{
+    size_t avail;
+    LAT_TIMED(t, TLSF_LAT_REALLOC,
+              avail = pool_try_expand(t, mem, min, preferred));
+    return avail;
+}
+#endif
+
+void tlsf_free_batch(tlsf_t *t, void *const *ptrs, size_t n)
+{
+    const size_t ahead = TLSF_FREE_AHEAD;
+    for (size_t i = 0; i < n; i++) {
+        /* Headers two strides out, then neighbours and bins one stride
+         * out, then the actual free: a three-stage software pipeline.
+         */
+        if (i + 2 * ahead < n && ptrs[i + 2 * ahead])
+            PREFETCH_W(&block_from_payload(ptrs[i + 2 * ahead])->header);
+        if (i + ahead < n && ptrs[i + ahead])
+            free_prefetch(t, block_from_payload(ptrs[i + ahead]));
+        if (!ptrs[i])
+            continue;
+#ifdef TLSF_LATENCY
+        LAT_TIMED(t, TLSF_LAT_FREE, pool_free(t, ptrs[i]));
+#else
+        pool_free(t, ptrs[i]);
+#endif
+    }
+}
+
+/* Carve count free blocks of the size malloc(size) takes, each between
+ * used fences of BLOCK_SIZE_MIN so that it never coalesces: freed again,
+ * a reserved block goes back to the bin it came from.  The run is cut
+ * from one free block found as malloc would find it, growing a dynamic
+ * pool if need be.  The leading fence keeps the first block off whatever
+ * precedes the run, the last one keeps any slack at the end.  Each fence
+ * holds the distance to the next one, 0 in the last, so the handle (the
+ * leading fence) is all tlsf_unreserve() needs, and the chain survives
+ * the pool moving.
+ */
+void *tlsf_reserve(tlsf_t *t, size_t size, size_t count)
+{
+    if (!t || !count)
+        return NULL;
+
+    /* The size block_find_free() trims a malloc(size) block to. */
+    size_t bsize = adjust_size(size, ALIGN_SIZE);
+    if (bsize > TLSF_MAX_SIZE)
+        return NULL;
+#if TLSF_GOOD_FIT == 0
+    bsize = round_block_size(bsize);
+#endif
+    const size_t step = bsize + BLOCK_OVERHEAD + BLOCK_SPAN_MIN;
+    if (count > (TLSF_MAX_SIZE + BLOCK_OVERHEAD - BLOCK_SPAN_MIN) / step)
+        return NULL;
+    size_t span = BLOCK_SPAN_MIN + count * step - BLOCK_OVERHEAD;
+
+    uint32_t fl, sl;
+    size_t want = span;
+    tlsf_block_t *block = block_find_free(t, &want, &fl, &sl);
+    if (!block)
+        return NULL;
+    ASAN_UNPOISON(block_payload(block), block_size(block));
+    block_rtrim_free(t, block, span);
+
+    tlsf_block_t *fence = block;
+    block = block_split(fence, BLOCK_SIZE_MIN);
+    block_set_free(fence, false);
+    *(size_t *) block_payload(fence) = step;
+    void *lead = block_payload(fence);
+
+    for (size_t i = 0; i < count; i++) {
+        /* block_split() poisons the remainder it returns, and each
+         * remainder here is split again or becomes a used fence.
+         */
+        ASAN_UNPOISON(block_payload(block), block_size(block));
+        fence = block_split(block, bsize);
+        block_link_next(block);
+        block_set_prev_free(fence, true);
+        block_insert(t, block);
+        block_poison_free(block);
+
+        ASAN_UNPOISON(block_payload(fence), block_size(fence));
+        block = i + 1 < count ? block_split(fence, BLOCK_SIZE_MIN) : NULL;
+        block_set_free(fence, false);
+        *(size_t *) block_payload(fence) = block ? step : 0;
+    }
+    return lead;
+}
+
+void tlsf_unreserve(tlsf_t *t, void *reserve)
+{
+    if (!t)
+        return;
+
+    char *fence = (char *) reserve;
+    while (fence) {
+        size_t next = *(size_t *) fence;
+        pool_free(t, fence);
+        fence = next ? fence + next : NULL;
+    }
+}
+
 size_t tlsf_append_pool(tlsf_t *t, void *mem, size_t size)
 {
     if (UNLIKELY(!t || !mem || !size))
@@ -993,13 +1760,8 @@ size_t tlsf_pool_init(tlsf_t *t, void *mem, size_t bytes)
     /* Clear any stale ASan shadow in the provided memory. */
     ASAN_UNPOISON(mem, bytes);
 
-    /* Zero-initialize the control structure, then point every bin at the
-     * sentinel so that free-list insert/remove can write unconditionally.
-     */
-    memset(t, 0, sizeof(*t));
-    for (uint32_t i = 0; i < FL_COUNT; i++)
-        for (uint32_t j = 0; j < SL_COUNT; j++)
-            t->block[i][j] = &t->block_null;
+    /* Empty bitmaps; the bin heads are left as they are. */
+    control_reset(t);
 
     /* Align pool start */
     char *start = align_ptr((char *) mem, ALIGN_SIZE);
@@ -1019,19 +1781,22 @@ size_t tlsf_pool_init(tlsf_t *t, void *mem, size_t bytes)
 
     /* Mark as static (fixed-size) pool */
     t->arena = start;
+#ifdef TLSF_COMPACT
+    t->base = start;
+#endif
 
-    /* Set up the initial free block.
-     * The block struct starts at start - BLOCK_OVERHEAD so that
-     * block->header aligns with start.  The prev field sits before
-     * the arena and is never accessed for the first block.
+    /* Set up the initial free block with its header at start.  In the
+     * default layout the prev field sits before the arena and is never
+     * accessed for the first block.
      */
-    tlsf_block_t *block = to_block(start - BLOCK_OVERHEAD);
+    tlsf_block_t *block = block_from_header(start);
     block->header = free_size | BLOCK_BIT_FREE;
     block_insert(t, block);
 
     /* Set up sentinel at the end of the free block */
-    tlsf_block_t *sentinel = block_link_next(block);
+    tlsf_block_t *sentinel = block_next(block);
     sentinel->header = BLOCK_BIT_PREV_FREE;
+    block_link_next(block);
     check_sentinel(sentinel);
 
     t->size = free_size + 2 * BLOCK_OVERHEAD;
@@ -1049,32 +1814,151 @@ void tlsf_pool_reset(tlsf_t *t)
     /* Unpoison the entire pool for ASan. */
     ASAN_UNPOISON(t->arena, t->size);
 
-    /* Clear bitmaps. */
+    /* Clear bitmaps; the bin heads need no reset. */
     t->fl = 0;
     memset(t->sl, 0, sizeof(t->sl));
 
-    /* Reset all bin pointers to sentinel. */
-    for (uint32_t i = 0; i < FL_COUNT; i++)
-        for (uint32_t j = 0; j < SL_COUNT; j++)
-            t->block[i][j] = &t->block_null;
-
     /* Reconstruct the single free block spanning the entire pool.
      * Same layout as the second half of tlsf_pool_init().
      */
     size_t free_size = t->size - 2 * BLOCK_OVERHEAD;
 
-    tlsf_block_t *block = to_block((char *) t->arena - BLOCK_OVERHEAD);
+    tlsf_block_t *block = block_from_header((char *) t->arena);
     block->header = free_size | BLOCK_BIT_FREE;
     block_insert(t, block);
 
     /* Sentinel at the end of the pool. */
-    tlsf_block_t *sentinel = block_link_next(block);
+    tlsf_block_t *sentinel = block_next(block);
     sentinel->header = BLOCK_BIT_PREV_FREE;
+    block_link_next(block);
     check_sentinel(sentinel);
 
     block_poison_free(block);
 }
 
+/* Prefault stride: the smallest page size of any target with an MMU.
+ * Larger pages are just touched more than once.
+ */
+#define PREFAULT_STRIDE 4096
+
+/* Write-fault the page holding p without changing it or racing a store
+ * from another thread.  Guessing 0 first makes a fresh anonymous page
+ * take one write fault instead of a read fault for the load and a second,
+ * copy-on-write fault for the store.
+ */
+NO_ASAN static void prefault_byte(char *p)
+{
+    char v = 0;
+    if (!__atomic_compare_exchange_n(p, &v, 0, false, __ATOMIC_RELAXED,
+                                     __ATOMIC_RELAXED))
+        __atomic_compare_exchange_n(p, &v, v, false, __ATOMIC_RELAXED,
+                                    __ATOMIC_RELAXED);
+}
+
+int tlsf_pool_prefault(tlsf_t *t, unsigned flags)
+{
+    if (!t)
+        return -1;
+    if (!t->size)
+        return 0;
+
+    char *base = (char *) (t->arena ? t->arena : tlsf_resize(t, t->size));
+    if (!base)
+        return -1;
+
+    /* Strides from an unaligned base still hit every page in between;
+     * the last byte covers the final page.
+     */
+    for (size_t off = 0; off < t->size; off += PREFAULT_STRIDE)
+        prefault_byte(base + off);
+    prefault_byte(base + t->size - 1);
+
+    if (!(flags & TLSF_PREFAULT_LOCK))
+        return 0;
+#ifdef HAVE_MLOCK
+    uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t) base & ~(page - 1);
+    return mlock((void *) start, (uintptr_t) base + t->size - start);
+#else
+    return -1;
+#endif
+}
+
+/* Close a run of free blocks found by tlsf_rebuild: link the following
+ * block back to it and file it in its bin.
+ */
+INLINE void rebuild_free_run(tlsf_t *t, tlsf_block_t *run)
+{
+    block_set_prev_free(block_link_next(run), true);
+    block_insert(t, run);
+    block_poison_free(run);
+}
+
+int tlsf_rebuild(tlsf_t *t, void *arena, size_t size)
+{
+    if (!t || size % ALIGN_SIZE || size < 2 * BLOCK_OVERHEAD + BLOCK_SIZE_MIN ||
+        size - 2 * BLOCK_OVERHEAD > BLOCK_SIZE_MAX)
+        return -1;
+
+    /* A dynamic pool lives wherever tlsf_resize() says it does. */
+    bool dynamic = !arena;
+    if (dynamic && !(arena = tlsf_resize(t, size)))
+        return -1;
+    if ((size_t) arena % ALIGN_SIZE)
+        return -1;
+
+    ASAN_UNPOISON(arena, size);
+
+    /* Block sizes are the only state trusted.  Validate the whole chain
+     * before writing anything, so a malformed pool is left as it was for
+     * inspection or another attempt.
+     */
+    char *hdr = (char *) arena;
+    char *last = hdr + size - BLOCK_OVERHEAD; /* Sentinel header */
+    while (hdr < last) {
+        size_t bsize = block_size(block_from_header(hdr));
+        if (bsize < BLOCK_SIZE_MIN || bsize % ALIGN_SIZE ||
+            bsize > (size_t) (last - hdr) - BLOCK_OVERHEAD)
+            return -1;
+        hdr += BLOCK_OVERHEAD + bsize;
+    }
+    tlsf_block_t *sentinel = block_from_header(last);
+    if (block_size(sentinel) || block_is_free(sentinel))
+        return -1;
+
+    control_reset(t);
+    t->arena = dynamic ? NULL : arena;
+#ifdef TLSF_COMPACT
+    t->base = (char *) arena;
+#endif
+    t->size = size;
+
+    /* Free/prev-free bits are recomputed and the links and boundary tags
+     * rewritten.  Adjacent free blocks (a free interrupted before
+     * coalescing) are merged.
+     */
+    tlsf_block_t *run = NULL; /* Open free block, if any */
+    for (hdr = (char *) arena; hdr < last;) {
+        tlsf_block_t *block = block_from_header(hdr);
+        size_t bsize = block_size(block);
+        hdr += BLOCK_OVERHEAD + bsize;
+
+        if (block_is_free(block) && run) {
+            run->header += bsize + BLOCK_OVERHEAD;
+            continue;
+        }
+        block_set_prev_free(block, false);
+        if (run)
+            rebuild_free_run(t, run);
+        run = block_is_free(block) ? block : NULL;
+    }
+
+    block_set_prev_free(sentinel, false);
+    if (run)
+        rebuild_free_run(t, run);
+    return 0;
+}
+
 #ifdef TLSF_ENABLE_CHECK
 #include <stdio.h>
 #include <stdlib.h>
@@ -1116,7 +2000,7 @@ void tlsf_check(tlsf_t *t)
      * tlsf_block_t structure's prev field precedes the header, but for
      * the first block, the prev field is outside the arena (never accessed).
      */
-    tlsf_block_t *block = to_block((char *) arena_start - BLOCK_OVERHEAD);
+    tlsf_block_t *block = block_from_header((char *) arena_start);
     tlsf_block_t *prev_block = NULL;
     size_t walk_free_count = 0;
     size_t total_size = 0;
@@ -1131,7 +2015,8 @@ void tlsf_check(tlsf_t *t)
         CHECK(bsize % ALIGN_SIZE == 0, "block size not aligned");
 
         /* Pointer alignment check */
-        CHECK((size_t) block % ALIGN_SIZE == 0, "block pointer not aligned");
+        CHECK((size_t) block % sizeof(size_t) == 0,
+              "block pointer not aligned");
         CHECK((size_t) block_payload(block) % ALIGN_SIZE == 0,
               "payload not aligned");
 
@@ -1140,7 +2025,7 @@ void tlsf_check(tlsf_t *t)
             CHECK(block_is_prev_free(block) == prev_was_free,
                   "prev_free bit mismatch with actual previous block state");
             if (prev_was_free) {
-                CHECK(block->prev == prev_block,
+                CHECK(block_prev(block) == prev_block,
                       "prev pointer doesn't match previous block");
             }
         }
@@ -1169,7 +2054,8 @@ void tlsf_check(tlsf_t *t)
     CHECK(block_is_prev_free(block) == prev_was_free,
           "sentinel prev_free bit mismatch");
     if (prev_was_free && prev_block) {
-        CHECK(block->prev == prev_block, "sentinel prev pointer incorrect");
+        CHECK(block_prev(block) == prev_block,
+              "sentinel prev pointer incorrect");
     }
 
     /* Account for sentinel header */
@@ -1182,18 +2068,14 @@ void tlsf_check(tlsf_t *t)
     size_t list_free_count = 0;
 
     for (uint32_t i = 0; i < FL_COUNT; ++i) {
-        uint32_t fl_bit = t->fl & (1U << i);
-        uint32_t sl_list = t->sl[i];
+        tlsf_flmap_t fl_bit = t->fl & FL_BIT(i);
+        tlsf_slmap_t sl_list = t->sl[i];
 
-        /* If FL bit is clear, all SL bits and block pointers must be
-         * the sentinel.
+        /* If FL bit is clear, all SL bits must be clear.  Heads of empty
+         * bins are never read, so their contents are not checked.
          */
         if (!fl_bit) {
             CHECK(sl_list == 0, "SL bitmap non-zero but FL bit is clear");
-            for (uint32_t j = 0; j < SL_COUNT; ++j) {
-                CHECK(t->block[i][j] == &t->block_null,
-                      "block pointer not sentinel but FL bit is clear");
-            }
             continue;
         }
 
@@ -1201,14 +2083,10 @@ void tlsf_check(tlsf_t *t)
         CHECK(sl_list != 0, "FL bit set but SL bitmap is empty");
 
         for (uint32_t j = 0; j < SL_COUNT; ++j) {
-            uint32_t sl_bit = sl_list & (1U << j);
-            tlsf_block_t *list_block = t->block[i][j];
-
-            if (!sl_bit) {
-                CHECK(list_block == &t->block_null,
-                      "block pointer not sentinel but SL bit is clear");
+            tlsf_slmap_t sl_bit = sl_list & SL_BIT(j);
+            if (!sl_bit)
                 continue;
-            }
+            tlsf_block_t *list_block = link_to_block(t, t->block[i][j]);
 
             /* SL bit is set, so block list must be non-empty */
             CHECK(list_block != &t->block_null,
@@ -1257,21 +2135,21 @@ void tlsf_check(tlsf_t *t)
                       "next block doesn't know this block is free");
 
                 /* Free list linkage */
-                CHECK(list_block->prev_free == list_prev,
+                CHECK(link_to_block(t, list_block->prev_free) == list_prev,
                       "free list prev pointer incorrect");
                 if (list_prev != &t->block_null) {
-                    CHECK(list_prev->next_free == list_block,
+                    CHECK(link_to_block(t, list_prev->next_free) == list_block,
                           "free list next pointer incorrect");
                 }
 
                 list_prev = list_block;
-                list_block = list_block->next_free;
+                list_block = link_to_block(t, list_block->next_free);
 
                 /* Floyd's tortoise-and-hare cycle detection */
                 if (fast != &t->block_null)
-                    fast = fast->next_free;
+                    fast = link_to_block(t, fast->next_free);
                 if (fast != &t->block_null)
-                    fast = fast->next_free;
+                    fast = link_to_block(t, fast->next_free);
                 CHECK(list_block == &t->block_null || list_block != fast,
                       "cycle in free list (duplicate block / double-free?)");
             }
@@ -1326,7 +2204,7 @@ int tlsf_get_stats(tlsf_t *t, tlsf_stats_t *stats)
     if (!arena_start)
         return -1;
 
-    tlsf_block_t *block = to_block((char *) arena_start - BLOCK_OVERHEAD);
+    tlsf_block_t *block = block_from_header((char *) arena_start);
 
     while (block_size(block) != 0) {
         size_t bsize = block_size(block);
@@ -1350,3 +2228,114 @@ int tlsf_get_stats(tlsf_t *t, tlsf_stats_t *stats)
 
     return 0;
 }
+
+/* Per-mille ratio num/den, computed in 64 bits so 32-bit targets do not
+ * overflow on num * 1000.
+ */
+static uint32_t permille(size_t num, size_t den)
+{
+    if (!den)
+        return 0;
+    return (uint32_t) ((uint64_t) num * 1000 / (uint64_t) den);
+}
+
+/**
+ * Collect the free-block histogram from the segregated free lists.
+ *
+ * Only bins whose SL bits are set are walked: bin heads are stale until
+ * a block is inserted, and are only ever read while their bit is set.
+ */
+int tlsf_get_histogram(tlsf_t *t, tlsf_histogram_t *hist)
+{
+    if (!t || !hist)
+        return -1;
+
+    memset(hist, 0, sizeof(*hist));
+
+    size_t fl_bytes[FL_COUNT] = {0};
+    for (tlsf_flmap_t fl_map = t->fl; fl_map; fl_map &= fl_map - 1) {
+        uint32_t i = fl_ffs(fl_map);
+        for (tlsf_slmap_t sl_map = t->sl[i]; sl_map; sl_map &= sl_map - 1) {
+            uint32_t j = sl_ffs(sl_map);
+            for (tlsf_block_t *b = link_to_block(t, t->block[i][j]);
+                 b != &t->block_null; b = link_to_block(t, b->next_free)) {
+                size_t bsize = block_size(b);
+                hist->count[i][j]++;
+                hist->bytes[i][j] += bsize;
+                if (bsize > hist->largest_free)
+                    hist->largest_free = bsize;
+            }
+            hist->free_count += hist->count[i][j];
+            fl_bytes[i] += hist->bytes[i][j];
+        }
+        hist->total_free += fl_bytes[i];
+    }
+
+    hist->frag = hist->total_free
+                     ? 1000 - permille(hist->largest_free, hist->total_free)
+                     : 0;
+
+    /* Blocks in lower FL classes are all smaller than the class bound. */
+    size_t below = 0;
+    for (uint32_t i = 0; i < FL_COUNT; i++) {
+        hist->class_frag[i] = permille(below, hist->total_free);
+        below += fl_bytes[i];
+    }
+
+    return 0;
+}
+
+size_t tlsf_bin_size(uint32_t fl, uint32_t sl)
+{
+    if (fl >= FL_COUNT || sl >= SL_COUNT)
+        return 0;
+    return mapping_size(fl, sl);
+}
+
+#ifdef TLSF_LATENCY
+int tlsf_get_latency(tlsf_t *t, tlsf_latency_t *lat, bool reset)
+{
+    if (!t || !lat)
+        return -1;
+    memcpy(lat, &t->latency, sizeof(*lat));
+    if (reset)
+        memset(&t->latency, 0, sizeof(t->latency));
+    return 0;
+}
+
+uint64_t tlsf_latency_bucket_min(unsigned bucket)
+{
+    if (bucket < 4)
+        return bucket;
+    unsigned e = (bucket >> 2) + 1;
+    return (uint64_t) (4 + (bucket & 3)) << (e - 2);
+}
+
+uint64_t tlsf_latency_percentile(const tlsf_latency_t *lat,
+                                 unsigned op,
+                                 unsigned permille)
+{
+    if (op >= TLSF_LAT_OPS || permille > 1000)
+        return 0;
+    const uint64_t *c = lat->count[op];
+    uint64_t total = 0;
+    for (unsigned b = 0; b < TLSF_LAT_BUCKETS; b++)
+        total += c[b];
+    if (!total)
+        return 0;
+
+    /* Rank of the operation we are after, 1-based and at least 1. */
+    uint64_t rank = (total * permille + 999) / 1000;
+    if (!rank)
+        rank = 1;
+    uint64_t seen = 0;
+    unsigned b = 0;
+    for (; b < TLSF_LAT_BUCKETS - 1; b++) {
+        seen += c[b];
+        if (seen >= rank)
+            break;
+    }
+    return b == TLSF_LAT_BUCKETS - 1 ? UINT64_MAX
+                                     : tlsf_latency_bucket_min(b + 1) - 1;
+}
+#endif
@@ -0,0 +1,94 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * Payload copy for relocating reallocs.
+ *
+ * A realloc that moves a block writes the whole new payload once.  With
+ * ordinary stores a large copy fills the cache with the destination and
+ * evicts the caller's working set to make room.  So copies of
+ * TLSF_STREAM_THRESHOLD bytes or more use non-temporal stores, which
+ * bypass the cache.  On x86-64 these are AVX2 stores when the build
+ * targets AVX2, and SSE2 stores otherwise.  On other targets, and below
+ * the threshold, memmove() is used.
+ *
+ * Streaming is slower while the destination still fits in the cache, so
+ * the default is 1 MB, half of a 2 MB L2; see tests/bench_copy.c.  0
+ * disables streaming.
+ *
+ * The copy runs upward, so it also serves the backward move of realloc:
+ * overlapping regions are allowed as long as dst <= src.
+ *
+ * Private to the allocator sources.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef TLSF_STREAM_THRESHOLD
+#define TLSF_STREAM_THRESHOLD (1024 * 1024)
+#endif
+
+#if TLSF_STREAM_THRESHOLD > 0 && defined(__x86_64__)
+#include <immintrin.h>
+
+#ifdef __AVX2__
+typedef __m256i tlsf_vec_t;
+#define TLSF_VEC_LOAD(p) _mm256_loadu_si256((const __m256i *) (p))
+#define TLSF_VEC_STREAM(p, v) _mm256_stream_si256((__m256i *) (p), (v))
+#else
+typedef __m128i tlsf_vec_t;
+#define TLSF_VEC_LOAD(p) _mm_loadu_si128((const __m128i *) (p))
+#define TLSF_VEC_STREAM(p, v) _mm_stream_si128((__m128i *) (p), (v))
+#endif
+
+static inline void tlsf_copy(void *dst, const void *src, size_t n)
+{
+    if (n < TLSF_STREAM_THRESHOLD) {
+        memmove(dst, src, n);
+        return;
+    }
+
+    char *d = (char *) dst;
+    const char *s = (const char *) src;
+
+    /* Ordinary stores up to the first cache line of the destination. */
+    size_t head = (size_t) (-(uintptr_t) d & 63);
+    memmove(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    /* One line per step, every load ahead of every store, so a
+     * destination below the source is never overwritten unread.
+     */
+    enum { PER_LINE = 64 / sizeof(tlsf_vec_t) };
+    for (; n >= 64; n -= 64, d += 64, s += 64) {
+        tlsf_vec_t v[PER_LINE];
+        for (size_t i = 0; i < PER_LINE; i++)
+            v[i] = TLSF_VEC_LOAD(s + i * sizeof(tlsf_vec_t));
+        for (size_t i = 0; i < PER_LINE; i++)
+            TLSF_VEC_STREAM(d + i * sizeof(tlsf_vec_t), v[i]);
+    }
+    /* Streaming stores are weakly ordered: drain them before the block is
+     * freed, handed out or published by a lock release.
+     */
+    _mm_sfence();
+    memmove(d, s, n);
+}
+
+#else
+
+static inline void tlsf_copy(void *dst, const void *src, size_t n)
+{
+    memmove(dst, src, n);
+}
+
+#endif
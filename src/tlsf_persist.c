@@ -0,0 +1,224 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * File-backed persistent TLSF heap.
+ *
+ * See include/tlsf_persist.h for the file layout and crash-consistency
+ * rules.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tlsf_persist.h"
+
+#define PERSIST_MAGIC 0x544c5346504f4f4cULL /* "TLSFPOOL" */
+
+/* Anything that changes the on-disk layout changes this. */
+#define PERSIST_LAYOUT ((uint32_t) sizeof(persist_header_t))
+
+enum { STATE_CLEAN = 1, STATE_OPEN = 2 };
+
+typedef struct {
+    uint64_t magic;
+    uint32_t layout;
+    uint32_t state;
+    uint64_t size; /* File size */
+    uint64_t pool; /* Pool offset in the file */
+    uint64_t addr; /* Address the file was last mapped at */
+    uint64_t root; /* Root object offset from the pool start; 0 if unset */
+    tlsf_t tlsf;
+} persist_header_t;
+
+static inline persist_header_t *header(const tlsf_persist_t *p)
+{
+    return (persist_header_t *) p->map;
+}
+
+static size_t header_bytes(void)
+{
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    return (sizeof(persist_header_t) + page - 1) & ~(page - 1);
+}
+
+/* Persist a state change before anything else is written. */
+static int set_state(tlsf_persist_t *p, uint32_t state)
+{
+    header(p)->state = state;
+    return msync(p->map, header_bytes(), MS_SYNC);
+}
+
+/* Map at the recorded address if it is free, anywhere otherwise. */
+static void *map_file(int fd, size_t size, void *hint)
+{
+    int flags = MAP_SHARED;
+#ifdef MAP_FIXED_NOREPLACE
+    if (hint)
+        flags |= MAP_FIXED_NOREPLACE;
+#endif
+    void *map = mmap(hint, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if (map == MAP_FAILED && hint)
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+static tlsf_open_status_t format(tlsf_persist_t *p, size_t size)
+{
+    size_t pool = header_bytes();
+    if (size <= pool || ftruncate(p->fd, (off_t) size) ||
+        !(p->map = map_file(p->fd, size, NULL)))
+        return TLSF_OPEN_FAILED;
+    p->size = size;
+
+    persist_header_t *h = header(p);
+    if (!tlsf_pool_init(&h->tlsf, (char *) p->map + pool, size - pool)) {
+        errno = EINVAL;
+        return TLSF_OPEN_FAILED;
+    }
+    h->layout = PERSIST_LAYOUT;
+    h->size = size;
+    h->pool = pool;
+    h->addr = (uint64_t) (uintptr_t) p->map;
+    h->root = 0;
+    /* The magic goes last: a crash while formatting leaves no heap. */
+    h->magic = PERSIST_MAGIC;
+    return set_state(p, STATE_OPEN) ? TLSF_OPEN_FAILED : TLSF_OPEN_CREATED;
+}
+
+static tlsf_open_status_t resume(tlsf_persist_t *p, size_t size, int flags)
+{
+    persist_header_t h;
+    if (pread(p->fd, &h, sizeof(h), 0) != (ssize_t) sizeof(h) ||
+        h.magic != PERSIST_MAGIC || h.layout != PERSIST_LAYOUT ||
+        h.size != size || h.pool != header_bytes() || size <= h.pool ||
+        h.tlsf.size > size - h.pool) {
+        errno = EINVAL;
+        return TLSF_OPEN_FAILED;
+    }
+
+    void *hint = (void *) (uintptr_t) h.addr;
+    if (!(p->map = map_file(p->fd, size, hint)))
+        return TLSF_OPEN_FAILED;
+    p->size = size;
+
+    persist_header_t *hdr = header(p);
+    tlsf_open_status_t status = TLSF_OPEN_RESUMED;
+    if (p->map != hint)
+        status = TLSF_OPEN_RELOCATED;
+    else if (hdr->state != STATE_CLEAN || (flags & TLSF_PERSIST_VERIFY))
+        status = TLSF_OPEN_RECOVERED;
+
+    /* Flag the heap as in use before the rebuild writes to the pool. */
+    if (set_state(p, STATE_OPEN))
+        return TLSF_OPEN_FAILED;
+
+#ifdef TLSF_PROFILE
+    /* A profiler lives in the process that attached it; the rebuild
+     * below clears it too, a resume must do so by hand.
+     */
+    hdr->tlsf.prof = NULL;
+    hdr->tlsf.prof_countdown = 0;
+#endif
+
+    if (status != TLSF_OPEN_RESUMED) {
+        /* Rebuild into a scratch control first: a malformed chain then
+         * leaves the header as it was, state included, and the file can
+         * still be opened once repaired.  The control cannot simply be
+         * copied over on success since free lists end at its own
+         * sentinel, so the second rebuild relinks them to the header.
+         */
+        char *pool = (char *) p->map + hdr->pool;
+        tlsf_t scratch;
+        if (tlsf_rebuild(&scratch, pool, h.tlsf.size)) {
+            set_state(p, h.state);
+            errno = EINVAL;
+            return TLSF_OPEN_FAILED;
+        }
+        tlsf_rebuild(&hdr->tlsf, pool, h.tlsf.size);
+        hdr->addr = (uint64_t) (uintptr_t) p->map;
+    }
+    return status;
+}
+
+tlsf_open_status_t tlsf_pool_open(tlsf_persist_t *p,
+                                  const char *path,
+                                  size_t size,
+                                  int flags)
+{
+    memset(p, 0, sizeof(*p));
+    p->fd = open(path, O_RDWR | ((flags & TLSF_PERSIST_CREATE) ? O_CREAT : 0),
+                 0600);
+    if (p->fd < 0)
+        return TLSF_OPEN_FAILED;
+
+    struct stat st;
+    tlsf_open_status_t status = TLSF_OPEN_FAILED;
+    if (!fstat(p->fd, &st)) {
+        if (st.st_size)
+            status = resume(p, (size_t) st.st_size, flags);
+        else if (flags & TLSF_PERSIST_CREATE)
+            status = format(p, size);
+        else
+            errno = EINVAL;
+    }
+
+    if (status == TLSF_OPEN_FAILED) {
+        int err = errno;
+        if (p->map)
+            munmap(p->map, p->size);
+        close(p->fd);
+        memset(p, 0, sizeof(*p));
+        p->fd = -1;
+        errno = err;
+        return status;
+    }
+
+    p->tlsf = &header(p)->tlsf;
+    p->pool = (char *) p->map + header(p)->pool;
+    return status;
+}
+
+int tlsf_pool_sync(tlsf_persist_t *p)
+{
+    return msync(p->map, p->size, MS_SYNC);
+}
+
+int tlsf_pool_close(tlsf_persist_t *p)
+{
+    if (!p->map)
+        return 0;
+
+    /* Data first, then the CLEAN mark that vouches for it. */
+    int rc = msync(p->map, p->size, MS_SYNC);
+    if (!rc)
+        rc = set_state(p, STATE_CLEAN);
+
+    int err = errno;
+    munmap(p->map, p->size);
+    close(p->fd);
+    memset(p, 0, sizeof(*p));
+    p->fd = -1;
+    errno = err;
+    return rc;
+}
+
+void *tlsf_pool_root(const tlsf_persist_t *p)
+{
+    uint64_t root = header(p)->root;
+    return root ? p->pool + root : NULL;
+}
+
+void tlsf_pool_set_root(tlsf_persist_t *p, void *ptr)
+{
+    header(p)->root = ptr ? (uint64_t) ((char *) ptr - p->pool) : 0;
+}
@@ -0,0 +1,138 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * Static tracepoints (USDT) for bpftrace, perf and SystemTap.
+ *
+ * Build with -DTLSF_USDT to place probes on the allocator paths.  Each
+ * probe is a single nop in the code plus an ELF note (.note.stapsdt)
+ * naming the probe and describing where its arguments live, so a probe
+ * costs one nop until a tracer attaches and patches it:
+ *
+ *   bpftrace -e 'usdt:./app:tlsf_thread:fallback { @[arg1, arg2] = count(); }'
+ *   perf buildid-cache --add ./app && perf record -e sdt_tlsf:grow ./app
+ *
+ * <sys/sdt.h> from SystemTap is used when available.  Otherwise an
+ * equivalent note is emitted here directly, for x86-64 and AArch64 ELF
+ * targets.  Every argument is passed as a 64-bit unsigned value; cast
+ * to int64 in scripts to read the -1 arena index of a failed fallback.
+ *
+ * Without TLSF_USDT the probes compile to nothing.
+ *
+ * Private to the allocator sources; the probe list is in the README.
+ */
+
+#pragma once
+
+#ifdef TLSF_USDT
+
+#include <stdint.h>
+
+#define TLSF_PROBE_U64(x) ((uint64_t) (uintptr_t) (x))
+
+#if defined(__has_include) && !defined(TLSF_USDT_BUILTIN)
+#if __has_include(<sys/sdt.h>)
+#define TLSF_USDT_SDT_H 1
+#endif
+#endif
+
+#ifdef TLSF_USDT_SDT_H
+#include <sys/sdt.h>
+
+#define TLSF_PROBE1(p, n, a) STAP_PROBE1(p, n, TLSF_PROBE_U64(a))
+#define TLSF_PROBE2(p, n, a, b) \
+    STAP_PROBE2(p, n, TLSF_PROBE_U64(a), TLSF_PROBE_U64(b))
+#define TLSF_PROBE3(p, n, a, b, c)                            \
+    STAP_PROBE3(p, n, TLSF_PROBE_U64(a), TLSF_PROBE_U64(b), \
+                TLSF_PROBE_U64(c))
+#define TLSF_PROBE4(p, n, a, b, c, d)                         \
+    STAP_PROBE4(p, n, TLSF_PROBE_U64(a), TLSF_PROBE_U64(b), \
+                TLSF_PROBE_U64(c), TLSF_PROBE_U64(d))
+#define TLSF_PROBE5(p, n, a, b, c, d, e)                      \
+    STAP_PROBE5(p, n, TLSF_PROBE_U64(a), TLSF_PROBE_U64(b), \
+                TLSF_PROBE_U64(c), TLSF_PROBE_U64(d), TLSF_PROBE_U64(e))
+#define TLSF_PROBE6(p, n, a, b, c, d, e, f)                                \
+    STAP_PROBE6(p, n, TLSF_PROBE_U64(a), TLSF_PROBE_U64(b),              \
+                TLSF_PROBE_U64(c), TLSF_PROBE_U64(d), TLSF_PROBE_U64(e), \
+                TLSF_PROBE_U64(f))
+
+#elif defined(__ELF__) && (defined(__x86_64__) || defined(__aarch64__))
+
+/*
+ * The same note layout <sys/sdt.h> produces (version 3): probe address,
+ * address of the _.stapsdt.base anchor (lets tools correct for prelink),
+ * semaphore address (none), then provider, name and argument strings.
+ * Arguments are "8@<operand>", the operand printed by the compiler as
+ * an immediate, register or memory reference.
+ */
+#define TLSF_PROBE_ASM(p, n, args, ...)                                  \
+    __asm__ __volatile__(                                                \
+        "990: nop\n"                                                     \
+        ".pushsection .note.stapsdt,\"?\",\"note\"\n"                    \
+        ".balign 4\n"                                                    \
+        ".4byte 992f-991f, 994f-993f, 3\n"                               \
+        "991: .asciz \"stapsdt\"\n"                                      \
+        "992: .balign 4\n"                                               \
+        "993: .8byte 990b\n"                                             \
+        ".8byte _.stapsdt.base\n"                                        \
+        ".8byte 0\n"                                                     \
+        ".asciz \"" #p "\"\n"                                            \
+        ".asciz \"" #n "\"\n"                                            \
+        ".asciz \"" args "\"\n"                                          \
+        "994: .balign 4\n"                                               \
+        ".popsection\n"                                                  \
+        ".ifndef _.stapsdt.base\n"                                       \
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\","                \
+        ".stapsdt.base,comdat\n"                                         \
+        ".weak _.stapsdt.base\n"                                         \
+        ".hidden _.stapsdt.base\n"                                       \
+        "_.stapsdt.base: .space 1\n"                                     \
+        ".size _.stapsdt.base, 1\n"                                      \
+        ".popsection\n"                                                  \
+        ".endif\n" ::__VA_ARGS__)
+
+#define TLSF_PROBE_OP(x) "nor"(TLSF_PROBE_U64(x))
+
+#define TLSF_PROBE1(p, n, a) TLSF_PROBE_ASM(p, n, "8@%0", TLSF_PROBE_OP(a))
+#define TLSF_PROBE2(p, n, a, b)                                     \
+    TLSF_PROBE_ASM(p, n, "8@%0 8@%1", TLSF_PROBE_OP(a), TLSF_PROBE_OP(b))
+#define TLSF_PROBE3(p, n, a, b, c)                                 \
+    TLSF_PROBE_ASM(p, n, "8@%0 8@%1 8@%2", TLSF_PROBE_OP(a),      \
+                   TLSF_PROBE_OP(b), TLSF_PROBE_OP(c))
+#define TLSF_PROBE4(p, n, a, b, c, d)                              \
+    TLSF_PROBE_ASM(p, n, "8@%0 8@%1 8@%2 8@%3", TLSF_PROBE_OP(a), \
+                   TLSF_PROBE_OP(b), TLSF_PROBE_OP(c), TLSF_PROBE_OP(d))
+#define TLSF_PROBE5(p, n, a, b, c, d, e)                                  \
+    TLSF_PROBE_ASM(p, n, "8@%0 8@%1 8@%2 8@%3 8@%4", TLSF_PROBE_OP(a),   \
+                   TLSF_PROBE_OP(b), TLSF_PROBE_OP(c), TLSF_PROBE_OP(d), \
+                   TLSF_PROBE_OP(e))
+#define TLSF_PROBE6(p, n, a, b, c, d, e, f)                                 \
+    TLSF_PROBE_ASM(p, n, "8@%0 8@%1 8@%2 8@%3 8@%4 8@%5", TLSF_PROBE_OP(a), \
+                   TLSF_PROBE_OP(b), TLSF_PROBE_OP(c), TLSF_PROBE_OP(d),   \
+                   TLSF_PROBE_OP(e), TLSF_PROBE_OP(f))
+
+#else
+#error "TLSF_USDT needs <sys/sdt.h> or an x86-64/AArch64 ELF target"
+#endif
+
+#else /* !TLSF_USDT */
+
+/* Arguments are cast away as in ASAN_POISON(); they must be free of side
+ * effects so that the compiler drops them entirely.
+ */
+#define TLSF_PROBE1(p, n, a) ((void) (a))
+#define TLSF_PROBE2(p, n, a, b) ((void) (a), (void) (b))
+#define TLSF_PROBE3(p, n, a, b, c) ((void) (a), (void) (b), (void) (c))
+#define TLSF_PROBE4(p, n, a, b, c, d) \
+    ((void) (a), (void) (b), (void) (c), (void) (d))
+#define TLSF_PROBE5(p, n, a, b, c, d, e) \
+    ((void) (a), (void) (b), (void) (c), (void) (d), (void) (e))
+#define TLSF_PROBE6(p, n, a, b, c, d, e, f)                        \
+    ((void) (a), (void) (b), (void) (c), (void) (d), (void) (e), \
+     (void) (f))
+
+#endif /* TLSF_USDT */
@@ -0,0 +1,262 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * Sampling heap profiler.  See include/tlsf_prof.h.
+ *
+ * Two open-addressed tables share the caller's memory: distinct call
+ * stacks (never removed, they carry cumulative counts) and sampled blocks
+ * still allocated (removed on free by backward-shift deletion).  Both are
+ * kept at most 3/4 full.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define HAVE_BACKTRACE 1
+#endif
+
+#include "tlsf_prof.h"
+
+/* Stack slots get 1/STACK_SHARE of the table memory, live slots the rest. */
+#define STACK_SHARE 2
+
+static uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/* Largest power of two not above n, or 0. */
+static uint32_t floor_pow2(size_t n)
+{
+    uint32_t p = 1;
+    if (!n)
+        return 0;
+    while ((size_t) p * 2 <= n && p < (UINT32_C(1) << 30))
+        p *= 2;
+    return p;
+}
+
+/* Bytes to the next sample: exponential with mean p->rate. */
+static ptrdiff_t next_interval(tlsf_prof_t *p)
+{
+    /* xorshift64* */
+    p->rng ^= p->rng >> 12;
+    p->rng ^= p->rng << 25;
+    p->rng ^= p->rng >> 27;
+    uint64_t r = p->rng * 0x2545f4914f6cdd1dULL;
+    double u = (double) ((r >> 11) + 1) / 9007199254740992.0; /* (0, 1] */
+    double bytes = -log(u) * (double) p->rate;
+    if (bytes >= (double) PTRDIFF_MAX / 2)
+        return PTRDIFF_MAX / 2;
+    return (ptrdiff_t) bytes;
+}
+
+static uint32_t capture(void **pc)
+{
+#ifdef HAVE_BACKTRACE
+    void *frames[TLSF_PROF_DEPTH + 1];
+    int n = backtrace(frames, TLSF_PROF_DEPTH + 1);
+    if (n <= 1)
+        return 0;
+    /* Drop this profiler's own frame; the allocator entry stays as leaf. */
+    memcpy(pc, frames + 1, (size_t) (n - 1) * sizeof(*pc));
+    return (uint32_t) (n - 1);
+#else
+    pc[0] = __builtin_return_address(0);
+    return 1;
+#endif
+}
+
+/* Find or add the table entry for a stack; -1 if the table is full. */
+static int64_t stack_slot(tlsf_prof_t *p, void **pc, uint32_t depth)
+{
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    for (uint32_t i = 0; i < depth; i++)
+        h = mix64(h ^ (uint64_t) (uintptr_t) pc[i]);
+
+    for (uint32_t i = (uint32_t) h & p->stack_mask;;
+         i = (i + 1) & p->stack_mask) {
+        tlsf_prof_stack_t *s = &p->stacks[i];
+        if (!s->depth) {
+            if ((p->nstack + 1) * 4 > ((size_t) p->stack_mask + 1) * 3)
+                return -1;
+            s->hash = h;
+            s->depth = depth;
+            memcpy(s->pc, pc, depth * sizeof(*pc));
+            p->nstack++;
+            return i;
+        }
+        if (s->hash == h && s->depth == depth &&
+            !memcmp(s->pc, pc, depth * sizeof(*pc)))
+            return i;
+    }
+}
+
+static uint32_t live_home(const tlsf_prof_t *p, const void *ptr)
+{
+    return (uint32_t) mix64((uint64_t) (uintptr_t) ptr) & p->live_mask;
+}
+
+bool tlsf_prof_sample(tlsf_t *t, void *ptr, size_t size)
+{
+    tlsf_prof_t *p = t->prof;
+    if (!p) {
+        t->prof_countdown = PTRDIFF_MAX;
+        return false;
+    }
+    t->prof_countdown = next_interval(p);
+
+    if ((p->nlive + 1) * 4 > ((size_t) p->live_mask + 1) * 3) {
+        p->dropped++;
+        return false;
+    }
+    void *pc[TLSF_PROF_DEPTH];
+    uint32_t depth = capture(pc);
+    int64_t si = depth ? stack_slot(p, pc, depth) : -1;
+    if (si < 0) {
+        p->dropped++;
+        return false;
+    }
+
+    tlsf_prof_stack_t *s = &p->stacks[si];
+    s->live_count++;
+    s->live_bytes += size;
+    s->alloc_count++;
+    s->alloc_bytes += size;
+
+    uint32_t i = live_home(p, ptr);
+    while (p->live[i].ptr)
+        i = (i + 1) & p->live_mask;
+    p->live[i].ptr = ptr;
+    p->live[i].size = size;
+    p->live[i].stack = (uint32_t) si;
+    p->nlive++;
+    return true;
+}
+
+void tlsf_prof_release(tlsf_t *t, void *ptr)
+{
+    tlsf_prof_t *p = t->prof;
+    if (!p)
+        return;
+
+    uint32_t i = live_home(p, ptr);
+    for (; p->live[i].ptr != ptr; i = (i + 1) & p->live_mask)
+        if (!p->live[i].ptr)
+            return; /* Sampled before a reset */
+
+    tlsf_prof_stack_t *s = &p->stacks[p->live[i].stack];
+    s->live_count--;
+    s->live_bytes -= p->live[i].size;
+    p->nlive--;
+
+    /* Backward-shift deletion keeps every probe chain unbroken. */
+    for (uint32_t j = (i + 1) & p->live_mask; p->live[j].ptr;
+         j = (j + 1) & p->live_mask) {
+        uint32_t home = live_home(p, p->live[j].ptr);
+        if (((j - home) & p->live_mask) >= ((j - i) & p->live_mask)) {
+            p->live[i] = p->live[j];
+            i = j;
+        }
+    }
+    p->live[i].ptr = NULL;
+}
+
+int tlsf_prof_init(tlsf_prof_t *p, tlsf_t *t, void *mem, size_t bytes,
+                   size_t rate)
+{
+    memset(p, 0, sizeof(*p));
+    uint32_t nstack = floor_pow2(bytes / STACK_SHARE / sizeof(*p->stacks));
+    size_t stack_bytes = nstack * sizeof(*p->stacks);
+    uint32_t nlive = floor_pow2((bytes - stack_bytes) / sizeof(*p->live));
+    if (!t || !mem || nstack < 4 || nlive < 4)
+        return -1;
+
+    p->stacks = (tlsf_prof_stack_t *) mem;
+    p->live = (tlsf_prof_live_t *) ((char *) mem + stack_bytes);
+    p->stack_mask = nstack - 1;
+    p->live_mask = nlive - 1;
+    p->rate = rate ? rate : TLSF_PROF_RATE;
+    p->rng = mix64((uint64_t) (uintptr_t) t) | 1;
+    p->tlsf = t;
+    tlsf_prof_reset(p);
+
+#ifdef HAVE_BACKTRACE
+    /* The first backtrace() may load the unwinder and allocate; do it
+     * here rather than inside an allocation.
+     */
+    void *probe[2];
+    backtrace(probe, 2);
+#endif
+    t->prof = p;
+    t->prof_countdown = next_interval(p);
+    return 0;
+}
+
+void tlsf_prof_stop(tlsf_prof_t *p)
+{
+    if (p->tlsf && p->tlsf->prof == p) {
+        p->tlsf->prof = NULL;
+        p->tlsf->prof_countdown = PTRDIFF_MAX;
+    }
+}
+
+void tlsf_prof_reset(tlsf_prof_t *p)
+{
+    memset(p->stacks, 0, ((size_t) p->stack_mask + 1) * sizeof(*p->stacks));
+    memset(p->live, 0, ((size_t) p->live_mask + 1) * sizeof(*p->live));
+    p->nstack = p->nlive = p->dropped = 0;
+}
+
+int tlsf_prof_dump(const tlsf_prof_t *p, FILE *out)
+{
+    size_t live_count = 0, live_bytes = 0, alloc_count = 0, alloc_bytes = 0;
+    for (uint32_t i = 0; i <= p->stack_mask; i++) {
+        const tlsf_prof_stack_t *s = &p->stacks[i];
+        live_count += s->live_count;
+        live_bytes += s->live_bytes;
+        alloc_count += s->alloc_count;
+        alloc_bytes += s->alloc_bytes;
+    }
+    fprintf(out, "heap profile: %6zu: %8zu [%6zu: %8zu] @ heap_v2/%zu\n",
+            live_count, live_bytes, alloc_count, alloc_bytes, p->rate);
+
+    for (uint32_t i = 0; i <= p->stack_mask; i++) {
+        const tlsf_prof_stack_t *s = &p->stacks[i];
+        if (!s->depth)
+            continue;
+        fprintf(out, "%6zu: %8zu [%6zu: %8zu] @", s->live_count,
+                s->live_bytes, s->alloc_count, s->alloc_bytes);
+        for (uint32_t d = 0; d < s->depth; d++)
+            fprintf(out, " %p", s->pc[d]);
+        fputc('\n', out);
+    }
+
+#ifdef __linux__
+    FILE *maps = fopen("/proc/self/maps", "r");
+    if (maps) {
+        char buf[4096];
+        size_t n;
+        fputs("\nMAPPED_LIBRARIES:\n", out);
+        while ((n = fread(buf, 1, sizeof(buf), maps)) > 0)
+            fwrite(buf, 1, n, out);
+        fclose(maps);
+    }
+#endif
+    fflush(out);
+    return ferror(out) ? -1 : 0;
+}
@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * Scoped region allocator.  See include/tlsf_region.h.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "tlsf_region.h"
+
+#ifdef TLSF_ENABLE_ASSERT
+#include <assert.h>
+#define REGION_ASSERT(cond) assert(cond)
+#else
+#define REGION_ASSERT(cond) ((void) 0)
+#endif
+
+#define CHUNK_MIN ((size_t) 1024)
+
+/* Header of a chunk or of a dedicated large block. */
+struct tlsf_region_chunk {
+    tlsf_region_chunk_t *next;
+};
+
+/* Padded so the bump pointer starts TLSF_REGION_ALIGN aligned. */
+#define HDR                                                   \
+    ((sizeof(tlsf_region_chunk_t) + TLSF_REGION_ALIGN - 1) & \
+     ~(TLSF_REGION_ALIGN - 1))
+
+void tlsf_region_init(tlsf_region_t *r, tlsf_t *t, size_t chunk_size,
+                      size_t keep)
+{
+    memset(r, 0, sizeof(*r));
+    r->tlsf = t;
+    if (!chunk_size)
+        chunk_size = TLSF_REGION_CHUNK;
+    if (chunk_size < CHUNK_MIN)
+        chunk_size = CHUNK_MIN;
+    r->chunk_size = (chunk_size + TLSF_REGION_ALIGN - 1) &
+                    ~(TLSF_REGION_ALIGN - 1);
+    r->keep = keep;
+}
+
+void tlsf_region_end(tlsf_region_t *r, tlsf_region_mark_t m)
+{
+    /* Chunks come off newest first.  Keep the oldest ones, which the
+     * next scope takes first, so a steady request loop cycles through
+     * the same chunks and never goes back to the pool.
+     */
+    size_t n = 0;
+    for (tlsf_region_chunk_t *c = r->chunks; c != m.chunk; c = c->next) {
+        REGION_ASSERT(c && "mark does not belong to this region");
+        n++;
+    }
+    size_t excess = r->nspare + n > r->keep ? r->nspare + n - r->keep : 0;
+    while (r->chunks != m.chunk) {
+        tlsf_region_chunk_t *c = r->chunks;
+        r->chunks = c->next;
+        if (excess) {
+            excess--;
+            tlsf_free(r->tlsf, c);
+        } else {
+            c->next = r->spare;
+            r->spare = c;
+            r->nspare++;
+        }
+    }
+    while (r->large != m.large) {
+        tlsf_region_chunk_t *c = r->large;
+        REGION_ASSERT(c && "mark does not belong to this region");
+        r->large = c->next;
+        tlsf_free(r->tlsf, c);
+    }
+    r->cur = m.cur;
+    r->end = m.chunk ? (char *) m.chunk + r->chunk_size : NULL;
+}
+
+void tlsf_region_destroy(tlsf_region_t *r)
+{
+    tlsf_region_mark_t empty = {NULL, NULL, NULL};
+    tlsf_region_end(r, empty);
+    while (r->spare) {
+        tlsf_region_chunk_t *c = r->spare;
+        r->spare = c->next;
+        tlsf_free(r->tlsf, c);
+    }
+    r->nspare = 0;
+}
+
+/* Give a request that would waste much of a chunk a block of its own. */
+static void *alloc_large(tlsf_region_t *r, size_t align, size_t size)
+{
+    size_t off = (HDR + align - 1) & ~(align - 1);
+    if (size > TLSF_MAX_SIZE - off)
+        return NULL;
+    tlsf_region_chunk_t *c = (tlsf_region_chunk_t *) tlsf_aalloc(
+        r->tlsf, align > TLSF_REGION_ALIGN ? align : TLSF_REGION_ALIGN,
+        off + size);
+    if (!c)
+        return NULL;
+    c->next = r->large;
+    r->large = c;
+    return (char *) c + off;
+}
+
+void *tlsf_region_alloc_slow(tlsf_region_t *r, size_t align, size_t size)
+{
+    REGION_ASSERT(align && !(align & (align - 1)));
+    const size_t avail = r->chunk_size - HDR;
+    if (size > avail / 4 || align - 1 > avail / 4 - size)
+        return alloc_large(r, align, size);
+
+    tlsf_region_chunk_t *c = r->spare;
+    if (c) {
+        r->spare = c->next;
+        r->nspare--;
+    } else {
+        c = (tlsf_region_chunk_t *) tlsf_malloc(r->tlsf, r->chunk_size);
+        if (!c)
+            return NULL;
+    }
+    c->next = r->chunks;
+    r->chunks = c;
+    r->cur = (char *) c + HDR;
+    r->end = (char *) c + r->chunk_size;
+    /* Fits by construction: size + align - 1 <= avail / 4. */
+    return tlsf_region_aalloc(r, align, size);
+}
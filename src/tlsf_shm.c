@@ -0,0 +1,182 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * Process-shared TLSF heap.
+ *
+ * See include/tlsf_shm.h for the segment layout and API documentation.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "tlsf_shm.h"
+
+#define TLSF_SHM_MAGIC 0x544c5346U /* "TLSF" */
+
+/* Keep the pool start off the header's cache lines. */
+#define SHM_POOL_ALIGN 64
+
+/* Anything that changes the shared layout changes this. */
+#define SHM_LAYOUT ((uint32_t) sizeof(tlsf_shm_t))
+
+/*
+ * Take the heap lock and point tlsf_t's absolute fields at the caller's
+ * mapping.  Every process rewrites them on entry, so whatever a previous
+ * holder left there is never used.
+ */
+static void shm_lock(tlsf_shm_t *shm)
+{
+    if (pthread_mutex_lock(&shm->lock) == EOWNERDEAD) {
+        pthread_mutex_consistent(&shm->lock);
+        shm->owner_deaths++;
+    }
+    char *pool = (char *) shm + shm->pool;
+    shm->tlsf.arena = pool;
+    shm->tlsf.base = pool;
+}
+
+static inline void shm_unlock(tlsf_shm_t *shm)
+{
+    pthread_mutex_unlock(&shm->lock);
+}
+
+static inline int shm_owns(const tlsf_shm_t *shm, const void *ptr)
+{
+    uintptr_t p = (uintptr_t) ptr, pool = (uintptr_t) shm + shm->pool;
+    return p >= pool && p - (uintptr_t) shm < shm->size;
+}
+
+tlsf_shm_t *tlsf_shm_init(void *mem, size_t bytes)
+{
+    size_t pool = (sizeof(tlsf_shm_t) + SHM_POOL_ALIGN - 1) &
+                  ~(size_t) (SHM_POOL_ALIGN - 1);
+    if (!mem || (uintptr_t) mem % SHM_POOL_ALIGN || bytes <= pool)
+        return NULL;
+
+    tlsf_shm_t *shm = (tlsf_shm_t *) mem;
+    memset(shm, 0, sizeof(*shm));
+
+    /* Offsets are 32 bits wide; the rest of a larger segment is unused. */
+    size_t pool_bytes = bytes - pool;
+    if (pool_bytes > TLSF_MAX_SIZE)
+        pool_bytes = TLSF_MAX_SIZE;
+    if (!tlsf_pool_init(&shm->tlsf, (char *) mem + pool, pool_bytes))
+        return NULL;
+
+    pthread_mutexattr_t attr;
+    if (pthread_mutexattr_init(&attr))
+        return NULL;
+    int rc = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    if (!rc)
+        rc = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    if (!rc)
+        rc = pthread_mutex_init(&shm->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (rc)
+        return NULL;
+
+    shm->size = pool + pool_bytes;
+    shm->pool = pool;
+    shm->layout = SHM_LAYOUT;
+    /* Publish last: peers polling for the magic see a complete heap. */
+    __atomic_store_n(&shm->magic, TLSF_SHM_MAGIC, __ATOMIC_RELEASE);
+    return shm;
+}
+
+tlsf_shm_t *tlsf_shm_attach(void *mem, size_t bytes)
+{
+    tlsf_shm_t *shm = (tlsf_shm_t *) mem;
+    if (!mem || bytes < sizeof(*shm) ||
+        __atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != TLSF_SHM_MAGIC ||
+        shm->layout != SHM_LAYOUT || shm->size > bytes)
+        return NULL;
+    return shm;
+}
+
+void tlsf_shm_destroy(tlsf_shm_t *shm)
+{
+    if (!shm)
+        return;
+    pthread_mutex_destroy(&shm->lock);
+    shm->magic = 0;
+}
+
+void *tlsf_shm_malloc(tlsf_shm_t *shm, size_t size)
+{
+    shm_lock(shm);
+    void *ptr = tlsf_malloc(&shm->tlsf, size);
+    shm_unlock(shm);
+    return ptr;
+}
+
+void *tlsf_shm_aalloc(tlsf_shm_t *shm, size_t align, size_t size)
+{
+    shm_lock(shm);
+    void *ptr = tlsf_aalloc(&shm->tlsf, align, size);
+    shm_unlock(shm);
+    return ptr;
+}
+
+void *tlsf_shm_realloc(tlsf_shm_t *shm, void *ptr, size_t size)
+{
+    if (ptr && !shm_owns(shm, ptr))
+        return NULL;
+    shm_lock(shm);
+    void *new_ptr = tlsf_realloc(&shm->tlsf, ptr, size);
+    shm_unlock(shm);
+    return new_ptr;
+}
+
+void tlsf_shm_free(tlsf_shm_t *shm, void *ptr)
+{
+    if (!ptr || !shm_owns(shm, ptr))
+        return;
+    shm_lock(shm);
+    tlsf_free(&shm->tlsf, ptr);
+    shm_unlock(shm);
+}
+
+size_t tlsf_shm_offset(const tlsf_shm_t *shm, const void *ptr)
+{
+    return ptr ? (size_t) ((const char *) ptr - (const char *) shm) : 0;
+}
+
+void *tlsf_shm_ptr(tlsf_shm_t *shm, size_t offset)
+{
+    return offset && offset < shm->size ? (char *) shm + offset : NULL;
+}
+
+uint32_t tlsf_shm_owner_deaths(tlsf_shm_t *shm)
+{
+    shm_lock(shm);
+    uint32_t n = shm->owner_deaths;
+    shm_unlock(shm);
+    return n;
+}
+
+void tlsf_shm_check(tlsf_shm_t *shm)
+{
+    shm_lock(shm);
+    tlsf_check(&shm->tlsf);
+    shm_unlock(shm);
+}
+
+int tlsf_shm_stats(tlsf_shm_t *shm, tlsf_stats_t *stats)
+{
+    shm_lock(shm);
+    int rc = tlsf_get_stats(&shm->tlsf, stats);
+    shm_unlock(shm);
+    return rc;
+}
+
+void tlsf_shm_reset(tlsf_shm_t *shm)
+{
+    shm_lock(shm);
+    tlsf_pool_reset(&shm->tlsf);
+    shm_unlock(shm);
+}
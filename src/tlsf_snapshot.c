@@ -0,0 +1,215 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * Checkpoint and roll back a static TLSF pool.
+ *
+ * See include/tlsf_snapshot.h for the two backends and their costs.
+ */
+
+#define _GNU_SOURCE /* memfd_create */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "tlsf_snapshot.h"
+
+static size_t page_size(void)
+{
+    return (size_t) sysconf(_SC_PAGESIZE);
+}
+
+/* The pool must still be the one the snapshot state was set up for. */
+static bool pool_unchanged(const tlsf_snapshot_t *s)
+{
+    return s->tlsf->arena == s->arena && s->tlsf->size == s->size;
+}
+
+int tlsf_snapshot_init(tlsf_snapshot_t *s, tlsf_t *t, void *buf, size_t bytes)
+{
+    if (!s || !t || !t->arena || !buf || bytes < t->size)
+        return -1;
+    memset(s, 0, sizeof(*s));
+    s->tlsf = t;
+    s->arena = (char *) t->arena;
+    s->size = t->size;
+    s->copy = (char *) buf;
+    s->fd = -1;
+    s->pagemap = -1;
+    return tlsf_snapshot(s);
+}
+
+#ifdef __linux__
+
+/* /proc/self/pagemap entry bits (Documentation/admin-guide/mm/pagemap.rst) */
+#define PM_PRESENT (1ULL << 63)
+#define PM_SWAP (1ULL << 62)
+#define PM_FILE (1ULL << 61) /* Clear once a private page is copied */
+
+/* Hand one run of dirty pages to the backend. */
+static int cow_flush(tlsf_snapshot_t *s, size_t off, size_t len, bool commit)
+{
+    if (commit) {
+        for (size_t done = 0; done < len;) {
+            ssize_t n = pwrite(s->fd, s->arena + off + done, len - done,
+                               (off_t) (off + done));
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR)
+                    continue;
+                return -1;
+            }
+            done += (size_t) n;
+        }
+    }
+    /* Private copies go away; the next access reads the memfd. */
+    if (madvise(s->arena + off, len, MADV_DONTNEED))
+        return -1;
+    s->dirty += len / page_size();
+    return 0;
+}
+
+/*
+ * Walk the pool's page-table entries and flush every run of pages that
+ * were copied on write since the last snapshot or restore.
+ */
+static int cow_sync(tlsf_snapshot_t *s, bool commit)
+{
+    const size_t page = page_size(), npages = s->mapped / page;
+    const off_t first =
+        (off_t) ((uintptr_t) s->arena / page * sizeof(uint64_t));
+    uint64_t ent[512];
+    size_t run = 0, run_len = 0;
+
+    s->dirty = 0;
+    for (size_t i = 0; i < npages; i += 512) {
+        size_t n = npages - i < 512 ? npages - i : 512;
+        bool known = s->pagemap >= 0 &&
+                     pread(s->pagemap, ent, n * sizeof(*ent),
+                           first + (off_t) (i * sizeof(*ent))) ==
+                         (ssize_t) (n * sizeof(*ent));
+        for (size_t j = 0; j < n; j++) {
+            bool dirty = !known || ((ent[j] & (PM_PRESENT | PM_SWAP)) &&
+                                    !(ent[j] & PM_FILE));
+            if (dirty) {
+                if (!run_len)
+                    run = i + j;
+                run_len++;
+            } else if (run_len) {
+                if (cow_flush(s, run * page, run_len * page, commit))
+                    return -1;
+                run_len = 0;
+            }
+        }
+    }
+    if (run_len && cow_flush(s, run * page, run_len * page, commit))
+        return -1;
+    return 0;
+}
+
+size_t tlsf_snapshot_pool_init(tlsf_snapshot_t *s, tlsf_t *t, size_t bytes)
+{
+    if (!s || !t || !bytes)
+        return 0;
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+    s->pagemap = -1;
+
+    const size_t page = page_size();
+    s->mapped = (bytes + page - 1) & ~(page - 1);
+    s->fd = memfd_create("tlsf-snapshot", MFD_CLOEXEC);
+    if (s->fd < 0 || ftruncate(s->fd, (off_t) s->mapped))
+        goto fail;
+    void *map = mmap(NULL, s->mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                     s->fd, 0);
+    if (map == MAP_FAILED)
+        goto fail;
+    s->arena = (char *) map;
+
+    size_t usable = tlsf_pool_init(t, map, s->mapped);
+    if (!usable) {
+        errno = EINVAL;
+        goto fail;
+    }
+    s->tlsf = t;
+    s->size = t->size;
+    s->pagemap = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+    if (tlsf_snapshot(s))
+        goto fail;
+    return usable;
+
+fail:;
+    int err = errno;
+    tlsf_snapshot_destroy(s);
+    errno = err;
+    return 0;
+}
+
+#else /* !__linux__ */
+
+static int cow_sync(tlsf_snapshot_t *s, bool commit)
+{
+    (void) s;
+    (void) commit;
+    return -1;
+}
+
+size_t tlsf_snapshot_pool_init(tlsf_snapshot_t *s, tlsf_t *t, size_t bytes)
+{
+    (void) s;
+    (void) t;
+    (void) bytes;
+    errno = ENOSYS;
+    return 0;
+}
+
+#endif /* __linux__ */
+
+int tlsf_snapshot(tlsf_snapshot_t *s)
+{
+    if (!pool_unchanged(s))
+        return -1;
+    memcpy(&s->saved, s->tlsf, sizeof(s->saved));
+    if (s->fd >= 0)
+        return cow_sync(s, true);
+    memcpy(s->copy, s->arena, s->size);
+    s->dirty = (s->size + page_size() - 1) / page_size();
+    return 0;
+}
+
+int tlsf_restore(tlsf_snapshot_t *s)
+{
+    if (s->fd >= 0) {
+        if (cow_sync(s, false))
+            return -1;
+    } else {
+        memcpy(s->arena, s->copy, s->size);
+        s->dirty = (s->size + page_size() - 1) / page_size();
+    }
+    memcpy(s->tlsf, &s->saved, sizeof(s->saved));
+    return 0;
+}
+
+void tlsf_snapshot_destroy(tlsf_snapshot_t *s)
+{
+    if (!s)
+        return;
+    if (s->fd >= 0) {
+        if (s->arena)
+            munmap(s->arena, s->mapped);
+        close(s->fd);
+    }
+    if (s->pagemap >= 0)
+        close(s->pagemap);
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+    s->pagemap = -1;
+}
@@ -12,10 +12,147 @@
  * documentation.
  */
 
+#include <stdbool.h>
 #include <string.h>
 
+#include "tlsf_copy.h"
+#include "tlsf_probe.h"
 #include "tlsf_thread.h"
 
+#ifdef TLSF_LOCK_ADAPTIVE
+
+#ifdef __linux__
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <sched.h>
+#endif
+
+/* Spin-wait hint: lets the sibling hyperthread run and saves power. */
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+/*
+ * Sleep while *addr == val.  Spurious returns are harmless: the caller
+ * re-checks the ticket.  On Linux each waiter tags its sleep with a bit
+ * derived from its ticket, so a release wakes only the waiter whose turn
+ * it is instead of every parked thread (no thundering herd).
+ */
+static inline void lock_park(uint32_t *addr, uint32_t val, uint32_t ticket)
+{
+#ifdef __linux__
+    syscall(SYS_futex, addr, FUTEX_WAIT_BITSET_PRIVATE, val, NULL, NULL,
+            1U << (ticket % 32));
+#else
+    (void) addr;
+    (void) val;
+    (void) ticket;
+    sched_yield();
+#endif
+}
+
+static inline void lock_unpark(uint32_t *addr, uint32_t ticket)
+{
+#ifdef __linux__
+    syscall(SYS_futex, addr, FUTEX_WAKE_BITSET_PRIVATE, INT_MAX, NULL, NULL,
+            1U << (ticket % 32));
+#else
+    (void) addr;
+    (void) ticket;
+#endif
+}
+
+/*
+ * Spin until our ticket is served or the spin budget runs out.  Only the
+ * next waiter in line spins; those further back cannot get the lock
+ * within one critical section anyway, so they park at once and leave the
+ * CPU to the holder.
+ */
+static inline bool lock_spin(tlsf_adaptive_lock_t *l, uint32_t ticket)
+{
+#if TLSF_LOCK_SPIN_LIMIT > 0
+    for (unsigned i = 0; i < TLSF_LOCK_SPIN_LIMIT; i++) {
+        uint32_t owner = __atomic_load_n(&l->owner, __ATOMIC_ACQUIRE);
+        if (owner == ticket)
+            return true;
+        if (ticket - owner > 1)
+            return false;
+        cpu_relax();
+    }
+    return false;
+#else
+    while (__atomic_load_n(&l->owner, __ATOMIC_ACQUIRE) != ticket)
+        cpu_relax();
+    return true;
+#endif
+}
+
+/*
+ * Contended acquire.  Spin on the owner word for a bounded number of
+ * iterations, then park until our ticket comes up.
+ */
+void tlsf_adaptive_lock_wait(tlsf_adaptive_lock_t *l, uint32_t ticket)
+{
+    while (!lock_spin(l, ticket)) {
+        __atomic_fetch_add(&l->parked, 1, __ATOMIC_SEQ_CST);
+        uint32_t owner = __atomic_load_n(&l->owner, __ATOMIC_SEQ_CST);
+        if (owner != ticket)
+            lock_park(&l->owner, owner, ticket);
+        __atomic_fetch_sub(&l->parked, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void tlsf_adaptive_lock_wake(tlsf_adaptive_lock_t *l)
+{
+    lock_unpark(&l->owner, __atomic_load_n(&l->owner, __ATOMIC_RELAXED));
+}
+
+#endif /* TLSF_LOCK_ADAPTIVE */
+
+/*
+ * Latency accounting (TLSF_LATENCY).  A call's start tick travels with
+ * it through the fallback paths; whichever arena serves the call records
+ * the total while it still holds the lock, so no other synchronization
+ * is needed.  Without TLSF_LATENCY all of this compiles away.
+ */
+#ifdef TLSF_LATENCY
+#define LAT_NOW() TLSF_LATENCY_TICK()
+
+static inline void arena_lock(tlsf_arena_t *a)
+{
+    uint64_t start = TLSF_LATENCY_TICK();
+    TLSF_LOCK_ACQUIRE(&a->lock);
+    tlsf_latency_record(&a->latency, TLSF_LAT_LOCK,
+                        TLSF_LATENCY_TICK() - start);
+}
+
+/* Charge a call to the arena whose lock is held; op TLSF_LAT_OPS skips. */
+static inline void arena_charge(tlsf_arena_t *a, unsigned op, uint64_t start)
+{
+    if (op < TLSF_LAT_OPS)
+        tlsf_latency_record(&a->latency, op, TLSF_LATENCY_TICK() - start);
+}
+#else
+#define LAT_NOW() ((uint64_t) 0)
+#define arena_lock(a) TLSF_LOCK_ACQUIRE(&(a)->lock)
+static inline void arena_charge(tlsf_arena_t *a, unsigned op, uint64_t start)
+{
+    (void) a;
+    (void) op;
+    (void) start;
+}
+#endif
+
 /*
  * Hash the thread hint to select a preferred arena.
  *
@@ -52,61 +189,92 @@ static inline int arena_find(const tlsf_thread_t *ts, const void *ptr)
  * Try to allocate from arenas other than `skip`, using non-blocking
  * try-lock first, then blocking acquire.  Returns NULL if all arenas
  * are exhausted.
+ *
+ * Each fallback fires tlsf_thread:fallback with the preferred arena, the
+ * arena that served it (-1 if none), size, alignment (0 for malloc) and
+ * the phase that succeeded (1 try-lock, 2 blocking, 0 none).
  */
-static void *arena_fallback_malloc(tlsf_thread_t *ts, int skip, size_t size)
+static void *arena_fallback_malloc(tlsf_thread_t *ts,
+                                   int skip,
+                                   size_t size,
+                                   unsigned op,
+                                   uint64_t start)
 {
     void *ptr;
 
     /* Phase 1: non-blocking scan */
     for (int i = 1; i < ts->count; i++) {
-        int idx = (skip + i) % ts->count;
-        if (TLSF_LOCK_TRY(&ts->arenas[idx].lock)) {
-            ptr = tlsf_malloc(&ts->arenas[idx].pool, size);
-            TLSF_LOCK_RELEASE(&ts->arenas[idx].lock);
+        tlsf_arena_t *a = &ts->arenas[(skip + i) % ts->count];
+        if (TLSF_LOCK_TRY(&a->lock)) {
+            ptr = tlsf_malloc(&a->pool, size);
             if (ptr)
+                arena_charge(a, op, start);
+            TLSF_LOCK_RELEASE(&a->lock);
+            if (ptr) {
+                TLSF_PROBE6(tlsf_thread, fallback, ts, skip, a - ts->arenas,
+                            size, 0, 1);
                 return ptr;
+            }
         }
     }
 
     /* Phase 2: blocking scan */
     for (int i = 1; i < ts->count; i++) {
-        int idx = (skip + i) % ts->count;
-        TLSF_LOCK_ACQUIRE(&ts->arenas[idx].lock);
-        ptr = tlsf_malloc(&ts->arenas[idx].pool, size);
-        TLSF_LOCK_RELEASE(&ts->arenas[idx].lock);
+        tlsf_arena_t *a = &ts->arenas[(skip + i) % ts->count];
+        arena_lock(a);
+        ptr = tlsf_malloc(&a->pool, size);
         if (ptr)
+            arena_charge(a, op, start);
+        TLSF_LOCK_RELEASE(&a->lock);
+        if (ptr) {
+            TLSF_PROBE6(tlsf_thread, fallback, ts, skip, a - ts->arenas, size,
+                        0, 2);
             return ptr;
+        }
     }
 
+    TLSF_PROBE6(tlsf_thread, fallback, ts, skip, -1, size, 0, 0);
     return NULL;
 }
 
 static void *arena_fallback_aalloc(tlsf_thread_t *ts,
                                    int skip,
                                    size_t align,
-                                   size_t size)
+                                   size_t size,
+                                   uint64_t start)
 {
     void *ptr;
 
     for (int i = 1; i < ts->count; i++) {
-        int idx = (skip + i) % ts->count;
-        if (TLSF_LOCK_TRY(&ts->arenas[idx].lock)) {
-            ptr = tlsf_aalloc(&ts->arenas[idx].pool, align, size);
-            TLSF_LOCK_RELEASE(&ts->arenas[idx].lock);
+        tlsf_arena_t *a = &ts->arenas[(skip + i) % ts->count];
+        if (TLSF_LOCK_TRY(&a->lock)) {
+            ptr = tlsf_aalloc(&a->pool, align, size);
             if (ptr)
+                arena_charge(a, TLSF_LAT_AALLOC, start);
+            TLSF_LOCK_RELEASE(&a->lock);
+            if (ptr) {
+                TLSF_PROBE6(tlsf_thread, fallback, ts, skip, a - ts->arenas,
+                            size, align, 1);
                 return ptr;
+            }
         }
     }
 
     for (int i = 1; i < ts->count; i++) {
-        int idx = (skip + i) % ts->count;
-        TLSF_LOCK_ACQUIRE(&ts->arenas[idx].lock);
-        ptr = tlsf_aalloc(&ts->arenas[idx].pool, align, size);
-        TLSF_LOCK_RELEASE(&ts->arenas[idx].lock);
+        tlsf_arena_t *a = &ts->arenas[(skip + i) % ts->count];
+        arena_lock(a);
+        ptr = tlsf_aalloc(&a->pool, align, size);
         if (ptr)
+            arena_charge(a, TLSF_LAT_AALLOC, start);
+        TLSF_LOCK_RELEASE(&a->lock);
+        if (ptr) {
+            TLSF_PROBE6(tlsf_thread, fallback, ts, skip, a - ts->arenas, size,
+                        align, 2);
             return ptr;
+        }
     }
 
+    TLSF_PROBE6(tlsf_thread, fallback, ts, skip, -1, size, align, 0);
     return NULL;
 }
 
@@ -165,23 +333,37 @@ void tlsf_thread_destroy(tlsf_thread_t *ts)
     ts->count = 0;
 }
 
-void *tlsf_thread_malloc(tlsf_thread_t *ts, size_t size)
+/* malloc charged as `op`: TLSF_LAT_MALLOC, or TLSF_LAT_OPS when the
+ * caller (realloc) charges the whole call itself.
+ */
+static void *thread_malloc(tlsf_thread_t *ts,
+                           size_t size,
+                           unsigned op,
+                           uint64_t start)
 {
     if (!ts->count)
         return NULL;
 
     int preferred = arena_select(ts);
+    tlsf_arena_t *a = &ts->arenas[preferred];
     void *ptr;
 
     /* Fast path: thread-preferred arena. */
-    TLSF_LOCK_ACQUIRE(&ts->arenas[preferred].lock);
-    ptr = tlsf_malloc(&ts->arenas[preferred].pool, size);
-    TLSF_LOCK_RELEASE(&ts->arenas[preferred].lock);
+    arena_lock(a);
+    ptr = tlsf_malloc(&a->pool, size);
+    if (ptr)
+        arena_charge(a, op, start);
+    TLSF_LOCK_RELEASE(&a->lock);
     if (ptr)
         return ptr;
 
     /* Slow path: try remaining arenas. */
-    return arena_fallback_malloc(ts, preferred, size);
+    return arena_fallback_malloc(ts, preferred, size, op, start);
+}
+
+void *tlsf_thread_malloc(tlsf_thread_t *ts, size_t size)
+{
+    return thread_malloc(ts, size, TLSF_LAT_MALLOC, LAT_NOW());
 }
 
 void *tlsf_thread_aalloc(tlsf_thread_t *ts, size_t align, size_t size)
@@ -189,16 +371,20 @@ void *tlsf_thread_aalloc(tlsf_thread_t *ts, size_t align, size_t size)
     if (!ts->count)
         return NULL;
 
+    uint64_t start = LAT_NOW();
     int preferred = arena_select(ts);
+    tlsf_arena_t *a = &ts->arenas[preferred];
     void *ptr;
 
-    TLSF_LOCK_ACQUIRE(&ts->arenas[preferred].lock);
-    ptr = tlsf_aalloc(&ts->arenas[preferred].pool, align, size);
-    TLSF_LOCK_RELEASE(&ts->arenas[preferred].lock);
+    arena_lock(a);
+    ptr = tlsf_aalloc(&a->pool, align, size);
+    if (ptr)
+        arena_charge(a, TLSF_LAT_AALLOC, start);
+    TLSF_LOCK_RELEASE(&a->lock);
     if (ptr)
         return ptr;
 
-    return arena_fallback_aalloc(ts, preferred, align, size);
+    return arena_fallback_aalloc(ts, preferred, align, size, start);
 }
 
 void tlsf_thread_free(tlsf_thread_t *ts, void *ptr)
@@ -206,13 +392,16 @@ void tlsf_thread_free(tlsf_thread_t *ts, void *ptr)
     if (!ptr)
         return;
 
+    uint64_t start = LAT_NOW();
     int idx = arena_find(ts, ptr);
     if (idx < 0)
         return;
 
-    TLSF_LOCK_ACQUIRE(&ts->arenas[idx].lock);
-    tlsf_free(&ts->arenas[idx].pool, ptr);
-    TLSF_LOCK_RELEASE(&ts->arenas[idx].lock);
+    tlsf_arena_t *a = &ts->arenas[idx];
+    arena_lock(a);
+    tlsf_free(&a->pool, ptr);
+    arena_charge(a, TLSF_LAT_FREE, start);
+    TLSF_LOCK_RELEASE(&a->lock);
 }
 
 void *tlsf_thread_realloc(tlsf_thread_t *ts, void *ptr, size_t size)
@@ -225,9 +414,11 @@ void *tlsf_thread_realloc(tlsf_thread_t *ts, void *ptr, size_t size)
         return NULL;
     }
 
+    uint64_t start = LAT_NOW();
     int idx = arena_find(ts, ptr);
     if (idx < 0)
         return NULL;
+    tlsf_arena_t *a = &ts->arenas[idx];
 
     /*
      * Try in-place realloc within the owning arena.  We also grab
@@ -235,10 +426,12 @@ void *tlsf_thread_realloc(tlsf_thread_t *ts, void *ptr, size_t size)
      * to do a cross-arena relocation afterwards.
      */
     size_t old_size;
-    TLSF_LOCK_ACQUIRE(&ts->arenas[idx].lock);
+    arena_lock(a);
     old_size = tlsf_usable_size(ptr);
-    void *new_ptr = tlsf_realloc(&ts->arenas[idx].pool, ptr, size);
-    TLSF_LOCK_RELEASE(&ts->arenas[idx].lock);
+    void *new_ptr = tlsf_realloc(&a->pool, ptr, size);
+    if (new_ptr)
+        arena_charge(a, TLSF_LAT_REALLOC, start);
+    TLSF_LOCK_RELEASE(&a->lock);
 
     if (new_ptr)
         return new_ptr;
@@ -248,16 +441,18 @@ void *tlsf_thread_realloc(tlsf_thread_t *ts, void *ptr, size_t size)
      * The old block is untouched.  Allocate from any arena, copy,
      * then free the original.
      */
-    new_ptr = tlsf_thread_malloc(ts, size);
+    new_ptr = thread_malloc(ts, size, TLSF_LAT_OPS, start);
+    TLSF_PROBE5(tlsf_thread, migrate, ts, idx, ptr, new_ptr, size);
     if (!new_ptr)
         return NULL;
 
     size_t copy_size = old_size < size ? old_size : size;
-    memcpy(new_ptr, ptr, copy_size);
+    tlsf_copy(new_ptr, ptr, copy_size);
 
-    TLSF_LOCK_ACQUIRE(&ts->arenas[idx].lock);
-    tlsf_free(&ts->arenas[idx].pool, ptr);
-    TLSF_LOCK_RELEASE(&ts->arenas[idx].lock);
+    arena_lock(a);
+    tlsf_free(&a->pool, ptr);
+    arena_charge(a, TLSF_LAT_REALLOC, start);
+    TLSF_LOCK_RELEASE(&a->lock);
 
     return new_ptr;
 }
@@ -310,3 +505,29 @@ void tlsf_thread_reset(tlsf_thread_t *ts)
         TLSF_LOCK_RELEASE(&ts->arenas[i].lock);
     }
 }
+
+#ifdef TLSF_LATENCY
+int tlsf_thread_latency(tlsf_thread_t *ts,
+                        int arena,
+                        tlsf_latency_t *lat,
+                        bool reset)
+{
+    if (!ts || !lat || arena < -1 || arena >= ts->count)
+        return -1;
+
+    memset(lat, 0, sizeof(*lat));
+    for (int i = 0; i < ts->count; i++) {
+        if (arena >= 0 && i != arena)
+            continue;
+        tlsf_arena_t *a = &ts->arenas[i];
+        TLSF_LOCK_ACQUIRE(&a->lock);
+        for (unsigned op = 0; op < TLSF_LAT_OPS; op++)
+            for (unsigned b = 0; b < TLSF_LAT_BUCKETS; b++)
+                lat->count[op][b] += a->latency.count[op][b];
+        if (reset)
+            memset(&a->latency, 0, sizeof(a->latency));
+        TLSF_LOCK_RELEASE(&a->lock);
+    }
+    return 0;
+}
+#endif
@@ -148,6 +148,7 @@ static void usage(const char *name)
         "  -n num-blocks    Number of concurrent blocks (default: 10000)\n"
         "  -i iterations    Number of benchmark iterations (default: 50)\n"
         "  -w warmup        Warmup iterations before measuring (default: 5)\n"
+        "  -a align         Allocate with tlsf_aalloc at this alignment\n"
         "  -c               Clear allocated memory (memset to 0)\n"
         "  -q               Quiet mode (machine-readable output only)\n"
         "  -h               Show this help\n\n"
@@ -208,6 +209,18 @@ static size_t get_random_block_size(size_t blk_min, size_t blk_max)
     return blk_min;
 }
 
+static size_t alloc_align; /* -a: 0 for tlsf_malloc */
+static size_t alloc_failures;
+
+static inline void *bench_alloc(size_t size)
+{
+    void *p = alloc_align ? tlsf_aalloc(&t, alloc_align, size)
+                          : tlsf_malloc(&t, size);
+    if (!p)
+        alloc_failures++;
+    return p;
+}
+
 /* Reset allocator state for clean iteration */
 static void reset_allocator(void **blk_array, size_t num_blks)
 {
@@ -243,10 +256,10 @@ static double run_alloc_benchmark(size_t loops,
             } else {
                 /* 90% chance: free + malloc */
                 tlsf_free(&t, blk_array[next_idx]);
-                blk_array[next_idx] = tlsf_malloc(&t, blk_size);
+                blk_array[next_idx] = bench_alloc(blk_size);
             }
         } else {
-            blk_array[next_idx] = tlsf_malloc(&t, blk_size);
+            blk_array[next_idx] = bench_alloc(blk_size);
         }
         if (clear && blk_array[next_idx])
             memset(blk_array[next_idx], 0, blk_size);
@@ -279,7 +292,7 @@ int main(int argc, char **argv)
     bool quiet = false;
     int opt;
 
-    while ((opt = getopt(argc, argv, "s:l:n:i:w:cqh")) > 0) {
+    while ((opt = getopt(argc, argv, "s:l:n:i:w:a:cqh")) > 0) {
         switch (opt) {
         case 's':
             parse_size_arg(optarg, argv[0], &blk_min, &blk_max);
@@ -296,6 +309,11 @@ int main(int argc, char **argv)
         case 'w':
             warmup = parse_int_arg(optarg, argv[0]);
             break;
+        case 'a':
+            alloc_align = parse_int_arg(optarg, argv[0]);
+            if (!alloc_align || (alloc_align & (alloc_align - 1)))
+                usage(argv[0]);
+            break;
         case 'c':
             clear = true;
             break;
@@ -332,7 +350,9 @@ int main(int argc, char **argv)
         return 1;
     }
     max_size = blk_max * num_blks * 2; /* 2x for fragmentation headroom */
-    mem = malloc(max_size);
+    /* 64-byte aligned for any TLSF_ALIGN_SHIFT */
+    if (posix_memalign(&mem, 64, max_size))
+        mem = NULL;
     if (!mem) {
         fprintf(stderr, "Failed to allocate %zu bytes for pool\n", max_size);
         return 1;
@@ -363,6 +383,10 @@ int main(int argc, char **argv)
         printf("  Measured iterations: %zu\n", iterations);
         printf("  Pool size: %zu bytes (%.1f MB)\n", max_size,
                (double) max_size / (1024.0 * 1024.0));
+        printf("  SL subdivisions: %d (tlsf_t: %zu bytes)\n", _TLSF_SL_COUNT,
+               sizeof(tlsf_t));
+        if (alloc_align)
+            printf("  Alignment: %zu (tlsf_aalloc)\n", alloc_align);
         printf("  Clear memory: %s\n\n", clear ? "yes" : "no");
     }
 
@@ -388,6 +412,7 @@ int main(int argc, char **argv)
     if (!quiet)
         printf("Running benchmark (%zu iterations)...\n", iterations);
 
+    alloc_failures = 0;
     for (size_t i = 0; i < iterations; i++) {
         samples[i] = run_alloc_benchmark(loops, blk_min, blk_max, blk_array,
                                          num_blks, clear);
@@ -443,6 +468,7 @@ int main(int argc, char **argv)
         printf("  Peak RSS: %ld KB\n", usage_info.ru_maxrss);
 #endif
         printf("  Pool size: %.1f MB\n", (double) max_size / (1024.0 * 1024.0));
+        printf("  Failed allocations: %zu\n", alloc_failures);
 
         printf("\nVariability:\n");
         if (stats.mean > 0.0)
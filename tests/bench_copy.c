@@ -0,0 +1,250 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * Cost of relocating reallocs, for the copy itself and for the cache.
+ *
+ * Each round keeps a -w KB working set hot by walking a random cycle
+ * through its cache lines, then times one tlsf_realloc() that has to
+ * move a block of the given size (the block after it is in use), then
+ * walks the working set once more.  The slowdown of that walk over a
+ * walk with no copy in between is the working set the copy evicted.
+ *
+ * Built twice by the Makefile: bench_copy uses the allocator's streaming
+ * copy above TLSF_STREAM_THRESHOLD, bench_copy_memmove never streams.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tlsf.h"
+
+#define LINE 64
+
+/* Fast xorshift32 PRNG */
+static uint32_t xorshift_state = 1;
+
+static inline uint32_t xorshift32(void)
+{
+    uint32_t x = xorshift_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    xorshift_state = x;
+    return x;
+}
+
+static inline uint64_t get_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t median(uint64_t *v, size_t n)
+{
+    qsort(v, n, sizeof(*v), compare_u64);
+    return v[n / 2];
+}
+
+/* Link the lines of the working set into one random cycle, so the walk
+ * defeats the hardware prefetcher and every line costs a full miss if
+ * it was evicted.
+ */
+static void **ws_build(size_t lines)
+{
+    void **ws;
+    if (posix_memalign((void **) &ws, LINE, lines * LINE))
+        return NULL;
+    size_t *order = (size_t *) malloc(lines * sizeof(*order));
+    if (!order)
+        return NULL;
+    for (size_t i = 0; i < lines; i++)
+        order[i] = i;
+    for (size_t i = lines - 1; i > 0; i--) {
+        size_t j = xorshift32() % (i + 1), tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    const size_t stride = LINE / sizeof(void *);
+    for (size_t i = 0; i < lines; i++)
+        ws[order[i] * stride] = &ws[order[(i + 1) % lines] * stride];
+    free(order);
+    return ws;
+}
+
+/* Time one pass over the working set. */
+static uint64_t ws_walk(void **ws, size_t lines)
+{
+    uint64_t start = get_time_ns();
+    void **p = ws;
+    for (size_t i = 0; i < lines; i++)
+        p = (void **) *p;
+    __asm__ __volatile__("" : : "r"(p) : "memory");
+    return get_time_ns() - start;
+}
+
+static void usage(const char *name)
+{
+    printf(
+        "TLSF relocating realloc benchmark: copy throughput and cache "
+        "impact.\n\n"
+        "Usage: %s [options]\n\n"
+        "Options:\n"
+        "  -s size          Block size to move; repeat for several "
+        "(default: 256K 1M 4M 16M)\n"
+        "  -w KB            Working set walked around each copy "
+        "(default: 512)\n"
+        "  -i iterations    Rounds per size (default: 20)\n"
+        "  -q               CSV output only\n"
+        "  -h               Show this help\n",
+        name);
+    exit(1);
+}
+
+static size_t parse_arg(const char *arg, const char *exe_name)
+{
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(arg, &end, 0);
+    if (errno || end == arg)
+        usage(exe_name);
+    switch (*end) {
+    case 'K':
+        v <<= 10;
+        end++;
+        break;
+    case 'M':
+        v <<= 20;
+        end++;
+        break;
+    }
+    if (*end != '\0')
+        usage(exe_name);
+    return (size_t) v;
+}
+
+int main(int argc, char **argv)
+{
+    size_t sizes[16], nsizes = 0, ws_kb = 512, iterations = 20;
+    int quiet = 0, opt;
+
+    while ((opt = getopt(argc, argv, "s:w:i:qh")) > 0) {
+        switch (opt) {
+        case 's':
+            if (nsizes == sizeof(sizes) / sizeof(sizes[0]))
+                usage(argv[0]);
+            sizes[nsizes++] = parse_arg(optarg, argv[0]);
+            break;
+        case 'w':
+            ws_kb = parse_arg(optarg, argv[0]);
+            break;
+        case 'i':
+            iterations = parse_arg(optarg, argv[0]);
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (!nsizes) {
+        const size_t defaults[] = {256 << 10, 1 << 20, 4 << 20, 16 << 20};
+        for (; nsizes < sizeof(defaults) / sizeof(defaults[0]); nsizes++)
+            sizes[nsizes] = defaults[nsizes];
+    }
+    size_t max_size = 0;
+    for (size_t i = 0; i < nsizes; i++) {
+        if (!sizes[i])
+            usage(argv[0]);
+        if (sizes[i] > max_size)
+            max_size = sizes[i];
+    }
+    if (!ws_kb || !iterations)
+        usage(argv[0]);
+
+    size_t pool_size = 2 * max_size + (1 << 20);
+    char *pool = (char *) mmap(NULL, pool_size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pool == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    /* Fault the pool in up front, so no copy pays for page faults. */
+    memset(pool, 0, pool_size);
+    tlsf_t t;
+    if (!tlsf_pool_init(&t, pool, pool_size)) {
+        fprintf(stderr, "tlsf_pool_init failed\n");
+        return 1;
+    }
+
+    size_t lines = (ws_kb << 10) / LINE;
+    void **ws = ws_build(lines);
+    uint64_t *copy_ns = (uint64_t *) malloc(iterations * sizeof(uint64_t));
+    uint64_t *walk_ns = (uint64_t *) malloc(iterations * sizeof(uint64_t));
+    uint64_t *base_ns = (uint64_t *) malloc(iterations * sizeof(uint64_t));
+    if (!ws || !copy_ns || !walk_ns || !base_ns) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    if (!quiet)
+        printf("Working set: %zu KB, %zu rounds per size\n", ws_kb,
+               iterations);
+    printf("size,copy_gbps,walk_ns_per_line,base_ns_per_line\n");
+    for (size_t k = 0; k < nsizes; k++) {
+        size_t size = sizes[k];
+        for (size_t i = 0; i < iterations; i++) {
+            char *p = (char *) tlsf_malloc(&t, size);
+            void *blocker = tlsf_malloc(&t, 64);
+            if (!p || !blocker) {
+                fprintf(stderr, "Pool too small for %zu bytes\n", size);
+                return 1;
+            }
+            memset(p, (int) i, size);
+
+            ws_walk(ws, lines);
+            base_ns[i] = ws_walk(ws, lines);
+
+            uint64_t start = get_time_ns();
+            char *q = (char *) tlsf_realloc(&t, p, size + LINE);
+            copy_ns[i] = get_time_ns() - start;
+            walk_ns[i] = ws_walk(ws, lines);
+
+            if (!q || q == p || q[size - 1] != (char) i) {
+                fprintf(stderr, "realloc did not relocate\n");
+                return 1;
+            }
+            tlsf_free(&t, blocker);
+            tlsf_free(&t, q);
+        }
+        double copy = (double) median(copy_ns, iterations);
+        double walk = (double) median(walk_ns, iterations) / (double) lines;
+        double base = (double) median(base_ns, iterations) / (double) lines;
+        printf("%zu,%.2f,%.2f,%.2f\n", size, (double) size / copy, walk,
+               base);
+    }
+    tlsf_check(&t);
+
+    free(copy_ns);
+    free(walk_ns);
+    free(base_ns);
+    free(ws);
+    munmap(pool, pool_size);
+    return 0;
+}
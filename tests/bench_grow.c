@@ -0,0 +1,200 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * Grow/shrink ping-pong of a dynamic pool.
+ *
+ * The pool sits in a reserved address range; tlsf_resize() commits pages
+ * with mprotect() when the pool grows and returns them with madvise() and
+ * mprotect() when it shrinks, as an mmap-backed heap would.  A few -n
+ * blocks stay live at the bottom of the pool, then each round allocates
+ * -k blocks at the top and frees them again in reverse order: with the
+ * default policy every round grows and shrinks the pool.
+ *
+ * Built twice by the Makefile: bench_grow with the default (exact) policy,
+ * bench_grow_hyst with growth chunks and shrink hysteresis.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tlsf.h"
+
+#define RESERVE ((size_t) 1 << 30)
+
+static char *arena;
+static size_t page, committed, resize_calls, resize_changes;
+
+void *tlsf_resize(tlsf_t *t, size_t req_size)
+{
+    (void) t;
+    if (req_size > RESERVE)
+        return NULL;
+    resize_calls++;
+    size_t want = (req_size + page - 1) & ~(page - 1);
+    if (want > committed) {
+        if (mprotect(arena + committed, want - committed,
+                     PROT_READ | PROT_WRITE))
+            return NULL;
+    } else if (want < committed) {
+        madvise(arena + want, committed - want, MADV_DONTNEED);
+        mprotect(arena + want, committed - want, PROT_NONE);
+    }
+    if (want != committed)
+        resize_changes++;
+    committed = want;
+    return arena;
+}
+
+/* Fast xorshift32 PRNG */
+static uint32_t xorshift_state = 1;
+
+static inline uint32_t xorshift32(void)
+{
+    uint32_t x = xorshift_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    xorshift_state = x;
+    return x;
+}
+
+static inline uint64_t get_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static void usage(const char *name)
+{
+    printf(
+        "TLSF dynamic pool grow/shrink benchmark.\n\n"
+        "Usage: %s [options]\n\n"
+        "Options:\n"
+        "  -s size|min:max  Block size or range (default: 64:4096)\n"
+        "  -n blocks        Blocks kept live below the churn (default: 64)\n"
+        "  -k blocks        Blocks allocated then freed per round; repeat "
+        "for several (default: 1 16 256)\n"
+        "  -l ops           Allocations per measurement (default: 100000)\n"
+        "  -q               CSV output only\n"
+        "  -h               Show this help\n",
+        name);
+    exit(1);
+}
+
+static size_t parse_arg(const char *arg, const char *exe_name)
+{
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(arg, &end, 0);
+    if (errno || end == arg || (*end != '\0' && *end != ':'))
+        usage(exe_name);
+    return (size_t) v;
+}
+
+int main(int argc, char **argv)
+{
+    size_t blk_min = 64, blk_max = 4096, live = 64, ops = 100000;
+    size_t bursts[16], nbursts = 0;
+    int quiet = 0, opt;
+
+    while ((opt = getopt(argc, argv, "s:n:k:l:qh")) > 0) {
+        switch (opt) {
+        case 's': {
+            const char *colon = strchr(optarg, ':');
+            blk_min = parse_arg(optarg, argv[0]);
+            blk_max = colon ? parse_arg(colon + 1, argv[0]) : blk_min;
+            break;
+        }
+        case 'n':
+            live = parse_arg(optarg, argv[0]);
+            break;
+        case 'k':
+            if (nbursts == sizeof(bursts) / sizeof(bursts[0]))
+                usage(argv[0]);
+            bursts[nbursts++] = parse_arg(optarg, argv[0]);
+            break;
+        case 'l':
+            ops = parse_arg(optarg, argv[0]);
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (!nbursts) {
+        bursts[nbursts++] = 1;
+        bursts[nbursts++] = 16;
+        bursts[nbursts++] = 256;
+    }
+    size_t max_burst = 0;
+    for (size_t i = 0; i < nbursts; i++)
+        if (bursts[i] > max_burst)
+            max_burst = bursts[i];
+    if (!blk_min || blk_min > blk_max || !max_burst || !ops)
+        usage(argv[0]);
+
+    page = (size_t) sysconf(_SC_PAGESIZE);
+    arena = (char *) mmap(NULL, RESERVE, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    void **ptrs = (void **) malloc((live + max_burst) * sizeof(void *));
+    if (arena == MAP_FAILED || !ptrs) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    if (!quiet)
+        printf("Sizes %zu:%zu, %zu live blocks, %zu allocations per run\n",
+               blk_min, blk_max, live, ops);
+    printf("burst,ns_per_op,resize_calls_per_kop,resizes_per_kop,peak_kb\n");
+    for (size_t b = 0; b < nbursts; b++) {
+        tlsf_t t = TLSF_INIT;
+        size_t k = bursts[b];
+        for (size_t i = 0; i < live; i++)
+            ptrs[i] = tlsf_malloc(&t, blk_min);
+
+        size_t peak = 0, done = 0;
+        resize_calls = resize_changes = 0;
+        uint64_t start = get_time_ns();
+        while (done < ops) {
+            for (size_t i = 0; i < k; i++) {
+                size_t size = blk_min;
+                if (blk_max > blk_min)
+                    size += xorshift32() % (blk_max - blk_min + 1);
+                ptrs[live + i] = tlsf_malloc(&t, size);
+                if (!ptrs[live + i]) {
+                    fprintf(stderr, "Allocation failed\n");
+                    return 1;
+                }
+            }
+            if (committed > peak)
+                peak = committed;
+            for (size_t i = k; i-- > 0;)
+                tlsf_free(&t, ptrs[live + i]);
+            done += k;
+        }
+        uint64_t ns = get_time_ns() - start;
+        tlsf_check(&t);
+
+        printf("%zu,%.1f,%.1f,%.1f,%zu\n", k, (double) ns / (double) done,
+               (double) resize_calls * 1000 / (double) done,
+               (double) resize_changes * 1000 / (double) done, peak >> 10);
+        for (size_t i = 0; i < live; i++)
+            tlsf_free(&t, ptrs[i]);
+    }
+
+    free(ptrs);
+    munmap(arena, RESERVE);
+    return 0;
+}
@@ -0,0 +1,192 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * tlsf_rebuild() cost per GB of pool.
+ *
+ * Fills a pool of -p MB with random-size blocks, frees a random -f
+ * percent of them so the chain mixes free and used blocks, then times
+ * repeated in-place rebuilds of the control structure.  The pool is
+ * already cached, so the figures are the CPU cost of the header walk;
+ * rebuilding a heap just paged in from disk adds the read time.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tlsf.h"
+
+static char *arena;
+static size_t arena_max;
+
+void *tlsf_resize(tlsf_t *t, size_t req_size)
+{
+    (void) t;
+    return req_size <= arena_max ? arena : NULL;
+}
+
+/* Fast xorshift32 PRNG */
+static uint32_t xorshift_state = 1;
+
+static inline uint32_t xorshift32(void)
+{
+    uint32_t x = xorshift_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    xorshift_state = x;
+    return x;
+}
+
+static inline uint64_t get_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static void usage(const char *name)
+{
+    printf(
+        "TLSF control-structure rebuild benchmark.\n\n"
+        "Usage: %s [options]\n\n"
+        "Options:\n"
+        "  -p MB            Pool size (default: 256)\n"
+        "  -s size|min:max  Block size or range (default: 64:4096)\n"
+        "  -f percent       Blocks freed before rebuilding (default: 50)\n"
+        "  -i iterations    Timed rebuilds (default: 10)\n"
+        "  -q               CSV output only\n"
+        "  -h               Show this help\n",
+        name);
+    exit(1);
+}
+
+static size_t parse_arg(const char *arg, const char *exe_name)
+{
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(arg, &end, 0);
+    if (errno || end == arg || (*end != '\0' && *end != ':'))
+        usage(exe_name);
+    return (size_t) v;
+}
+
+int main(int argc, char **argv)
+{
+    size_t pool_mb = 256, blk_min = 64, blk_max = 4096, iterations = 10;
+    unsigned free_pct = 50;
+    int quiet = 0, opt;
+
+    while ((opt = getopt(argc, argv, "p:s:f:i:qh")) > 0) {
+        switch (opt) {
+        case 'p':
+            pool_mb = parse_arg(optarg, argv[0]);
+            break;
+        case 's': {
+            const char *colon = strchr(optarg, ':');
+            blk_min = parse_arg(optarg, argv[0]);
+            blk_max = colon ? parse_arg(colon + 1, argv[0]) : blk_min;
+            break;
+        }
+        case 'f':
+            free_pct = (unsigned) parse_arg(optarg, argv[0]);
+            break;
+        case 'i':
+            iterations = parse_arg(optarg, argv[0]);
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (!pool_mb || !blk_min || blk_min > blk_max || free_pct > 100 ||
+        !iterations)
+        usage(argv[0]);
+
+    arena_max = pool_mb << 20;
+    arena = (char *) mmap(NULL, arena_max, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (arena == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    /* Fill the pool, keeping every pointer so a share can be freed. */
+    tlsf_t t = TLSF_INIT;
+    size_t cap = 1 << 16, count = 0;
+    void **ptrs = (void **) malloc(cap * sizeof(*ptrs));
+    uint64_t *ns = (uint64_t *) malloc(iterations * sizeof(*ns));
+    for (;;) {
+        size_t size = blk_min;
+        if (blk_max > blk_min)
+            size += xorshift32() % (blk_max - blk_min + 1);
+        void *p = tlsf_malloc(&t, size);
+        if (!p)
+            break;
+        if (count == cap) {
+            cap *= 2;
+            ptrs = (void **) realloc(ptrs, cap * sizeof(*ptrs));
+        }
+        if (!ptrs || !ns) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+        ptrs[count++] = p;
+    }
+    /* Keep the last block so the pool does not shrink. */
+    for (size_t i = 0; i + 1 < count; i++)
+        if (xorshift32() % 100 < free_pct)
+            tlsf_free(&t, ptrs[i]);
+    free(ptrs);
+
+    tlsf_stats_t st;
+    tlsf_get_stats(&t, &st);
+
+    size_t size = t.size;
+    for (size_t i = 0; i < iterations; i++) {
+        uint64_t start = get_time_ns();
+        if (tlsf_rebuild(&t, NULL, size)) {
+            fprintf(stderr, "tlsf_rebuild failed\n");
+            return 1;
+        }
+        ns[i] = get_time_ns() - start;
+    }
+    tlsf_check(&t);
+    qsort(ns, iterations, sizeof(*ns), compare_u64);
+
+    double median_ms = (double) ns[iterations / 2] / 1e6;
+    double gb = (double) size / (double) (1 << 30);
+    if (quiet) {
+        printf("%zu,%zu,%zu,%.3f,%.1f,%.2f\n", size, st.block_count,
+               st.free_count, median_ms, median_ms / gb,
+               (double) ns[iterations / 2] / (double) st.block_count);
+    } else {
+        printf("Rebuild: %zu MB pool, %zu blocks (%zu free), sizes %zu:%zu\n",
+               size >> 20, st.block_count, st.free_count, blk_min, blk_max);
+        printf("  median %.3f ms (min %.3f, max %.3f) over %zu runs\n",
+               median_ms, (double) ns[0] / 1e6,
+               (double) ns[iterations - 1] / 1e6, iterations);
+        printf("  %.1f ms/GB, %.2f ns/block\n", median_ms / gb,
+               (double) ns[iterations / 2] / (double) st.block_count);
+    }
+
+    free(ns);
+    munmap(arena, arena_max);
+    return 0;
+}
@@ -0,0 +1,248 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * Lock scalability benchmark for the per-arena TLSF wrapper.
+ *
+ * Runs the same malloc/free churn at 1, 2, 4, ... up to -t threads and
+ * reports aggregate throughput.  The lock primitive is chosen at compile
+ * time through the TLSF_LOCK_* macros, so the Makefile builds one binary
+ * per primitive:
+ *   build/bench_thread_mutex     pthread_mutex_t (default)
+ *   build/bench_thread_spin      ticket spinlock (TLSF_LOCK_SPIN_LIMIT=0)
+ *   build/bench_thread_adaptive  spin-then-park ticket lock
+ *
+ * Thread counts above the arena count (TLSF_ARENA_COUNT) force threads to
+ * share arenas, which is where the lock primitive dominates.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tlsf_thread.h"
+
+#if defined(TLSF_LOCK_ADAPTIVE) && TLSF_LOCK_SPIN_LIMIT == 0
+#define LOCK_NAME "spin"
+#elif defined(TLSF_LOCK_ADAPTIVE)
+#define LOCK_NAME "adaptive"
+#else
+#define LOCK_NAME "mutex"
+#endif
+
+#define MAX_THREADS 64
+#define LIVE_SLOTS 64 /* Live allocations kept per thread */
+
+static tlsf_thread_t ts;
+static pthread_barrier_t start_barrier;
+
+typedef struct {
+    pthread_t tid;
+    unsigned seed;
+    size_t ops;
+    size_t blk_min, blk_max;
+    size_t failures;
+    uint64_t start_ns, end_ns;
+} worker_t;
+
+static inline uint64_t get_time_ns(void)
+{
+    struct timespec tv;
+    clock_gettime(CLOCK_MONOTONIC, &tv);
+    return (uint64_t) tv.tv_sec * 1000000000ULL + (uint64_t) tv.tv_nsec;
+}
+
+static void *worker(void *arg)
+{
+    worker_t *w = (worker_t *) arg;
+    void *slots[LIVE_SLOTS] = {0};
+    size_t span = w->blk_max - w->blk_min + 1;
+
+    pthread_barrier_wait(&start_barrier);
+    w->start_ns = get_time_ns();
+
+    for (size_t i = 0; i < w->ops; i++) {
+        unsigned idx = (unsigned) rand_r(&w->seed) % LIVE_SLOTS;
+        if (slots[idx]) {
+            tlsf_thread_free(&ts, slots[idx]);
+            slots[idx] = NULL;
+        } else {
+            size_t sz = w->blk_min + (size_t) rand_r(&w->seed) % span;
+            slots[idx] = tlsf_thread_malloc(&ts, sz);
+            if (!slots[idx])
+                w->failures++;
+        }
+    }
+
+    for (unsigned i = 0; i < LIVE_SLOTS; i++)
+        tlsf_thread_free(&ts, slots[i]);
+    w->end_ns = get_time_ns();
+    return NULL;
+}
+
+/* Run one round with nthreads workers; return elapsed seconds.
+ * Elapsed time spans the earliest worker start to the latest worker end,
+ * so thread creation and scheduling of the main thread are excluded.
+ */
+static double run_round(worker_t *workers,
+                        int nthreads,
+                        size_t ops,
+                        size_t blk_min,
+                        size_t blk_max,
+                        size_t *failures)
+{
+    pthread_barrier_init(&start_barrier, NULL, (unsigned) nthreads + 1);
+
+    for (int i = 0; i < nthreads; i++) {
+        workers[i].seed = (unsigned) i * 2654435761U + 1;
+        workers[i].ops = ops;
+        workers[i].blk_min = blk_min;
+        workers[i].blk_max = blk_max;
+        workers[i].failures = 0;
+        pthread_create(&workers[i].tid, NULL, worker, &workers[i]);
+    }
+
+    pthread_barrier_wait(&start_barrier);
+    for (int i = 0; i < nthreads; i++)
+        pthread_join(workers[i].tid, NULL);
+
+    pthread_barrier_destroy(&start_barrier);
+
+    uint64_t start = UINT64_MAX, end = 0;
+    *failures = 0;
+    for (int i = 0; i < nthreads; i++) {
+        *failures += workers[i].failures;
+        if (workers[i].start_ns < start)
+            start = workers[i].start_ns;
+        if (workers[i].end_ns > end)
+            end = workers[i].end_ns;
+    }
+    return (double) (end - start) / 1e9;
+}
+
+static void usage(const char *name)
+{
+    printf(
+        "TLSF thread wrapper lock scalability benchmark.\n\n"
+        "Usage: %s [options]\n\n"
+        "Options:\n"
+        "  -t threads       Maximum thread count, doubled from 1 (default: "
+        "64)\n"
+        "  -l loops         Operations per thread (default: 200000)\n"
+        "  -s min:max       Block size range (default: 16:512)\n"
+        "  -p bytes         Pool size (default: 67108864)\n"
+        "  -q               CSV output (lock,threads,seconds,mops)\n"
+        "  -h               Show this help\n",
+        name);
+    exit(1);
+}
+
+static size_t parse_size(const char *arg, const char *exe_name)
+{
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(arg, &end, 0);
+    if (errno || end == arg || *end != '\0')
+        usage(exe_name);
+    return (size_t) v;
+}
+
+int main(int argc, char **argv)
+{
+    size_t max_threads = MAX_THREADS;
+    size_t ops = 200000;
+    size_t blk_min = 16, blk_max = 512;
+    size_t pool_size = (size_t) 64 << 20;
+    int quiet = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:l:s:p:qh")) > 0) {
+        switch (opt) {
+        case 't':
+            max_threads = parse_size(optarg, argv[0]);
+            break;
+        case 'l':
+            ops = parse_size(optarg, argv[0]);
+            break;
+        case 's': {
+            char *colon = strchr(optarg, ':');
+            if (colon) {
+                *colon = '\0';
+                blk_max = parse_size(colon + 1, argv[0]);
+            }
+            blk_min = parse_size(optarg, argv[0]);
+            if (!colon)
+                blk_max = blk_min;
+            break;
+        }
+        case 'p':
+            pool_size = parse_size(optarg, argv[0]);
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (!max_threads || max_threads > MAX_THREADS || !ops ||
+        blk_min > blk_max) {
+        fprintf(stderr, "Error: need 1 <= threads <= %d, loops > 0, "
+                        "min <= max\n",
+                MAX_THREADS);
+        return 1;
+    }
+
+    void *pool = malloc(pool_size);
+    if (!pool) {
+        fprintf(stderr, "Failed to allocate %zu bytes for pool\n", pool_size);
+        return 1;
+    }
+
+    worker_t workers[MAX_THREADS];
+
+    if (quiet) {
+        printf("lock,threads,seconds,mops\n");
+    } else {
+        printf("TLSF thread benchmark: lock=%s arenas=%d\n", LOCK_NAME,
+               TLSF_ARENA_COUNT);
+        printf("  Block size: %zu - %zu bytes, %zu ops/thread\n\n", blk_min,
+               blk_max, ops);
+        printf("  %8s %12s %12s %10s\n", "threads", "seconds", "Mops/s",
+               "failures");
+    }
+
+    for (size_t n = 1; n <= max_threads; n *= 2) {
+        if (!tlsf_thread_init(&ts, pool, pool_size)) {
+            fprintf(stderr, "tlsf_thread_init failed\n");
+            free(pool);
+            return 1;
+        }
+
+        size_t failures;
+        double secs =
+            run_round(workers, (int) n, ops, blk_min, blk_max, &failures);
+        double mops = (double) (n * ops) / secs / 1e6;
+
+        tlsf_thread_check(&ts);
+        tlsf_thread_destroy(&ts);
+
+        if (quiet)
+            printf("%s,%zu,%.6f,%.3f\n", LOCK_NAME, n, secs, mops);
+        else
+            printf("  %8zu %12.6f %12.3f %10zu\n", n, secs, mops, failures);
+    }
+
+    free(pool);
+    return 0;
+}
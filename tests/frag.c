@@ -0,0 +1,321 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * tlsf-bsd is freely redistributable under the BSD License. See the file
+ * "LICENSE" for information on usage and redistribution of this file.
+ */
+
+/*
+ * Fragmentation-over-time benchmark.
+ *
+ * tests/bench.c frees everything after each iteration, so it never sees
+ * fragmentation build up.  This program instead drives one static pool
+ * through hours of simulated time without a reset:
+ *   - Size phases rotate small -> large -> mixed every -P minutes, so
+ *     long-lived objects from one phase pin holes into the next.
+ *   - Each object is short-lived (seconds) or long-lived (up to -L
+ *     minutes); frees happen when the simulated clock reaches them.
+ * Every -S simulated seconds it samples tlsf_get_stats() and the
+ * allocation failure rate of the elapsed window.
+ *
+ * The workload is deterministic for a given seed, so builds with different
+ * TLSF_SPLIT_THRESHOLD / SL counts / TLSF_GOOD_FIT see identical request
+ * streams.  The Makefile builds one binary per configuration (build/frag_*),
+ * and scripts/frag_plot.py plots their CSV output side by side.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "tlsf.h"
+
+#ifdef TLSF_SPLIT_THRESHOLD
+#define SPLIT_LABEL TLSF_SPLIT_THRESHOLD
+#else
+#define SPLIT_LABEL 0 /* Allocator default: BLOCK_SIZE_MIN */
+#endif
+
+#ifdef TLSF_COMPACT
+#define LAYOUT_LABEL "-compact"
+#else
+#define LAYOUT_LABEL ""
+#endif
+
+#if defined(TLSF_GOOD_FIT) && TLSF_GOOD_FIT > 0
+#define FIT_LABEL "-goodfit"
+#else
+#define FIT_LABEL ""
+#endif
+
+/* Fast xorshift32 PRNG; deterministic across configurations. */
+static uint32_t xorshift_state = 1;
+
+static inline uint32_t xorshift32(void)
+{
+    uint32_t x = xorshift_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    xorshift_state = x;
+    return x;
+}
+
+static inline uint64_t rand_range(uint64_t lo, uint64_t hi)
+{
+    return hi > lo ? lo + (uint64_t) xorshift32() % (hi - lo + 1) : lo;
+}
+
+/* Size phases, cycled in order. */
+enum { PHASE_SMALL, PHASE_LARGE, PHASE_MIXED, PHASE_COUNT };
+static const char *phase_name[PHASE_COUNT] = {"small", "large", "mixed"};
+
+static size_t phase_size(int phase)
+{
+    switch (phase) {
+    case PHASE_SMALL:
+        return (size_t) rand_range(16, 256);
+    case PHASE_LARGE:
+        return (size_t) rand_range(512, 8192);
+    default: {
+        /* Log-uniform over 16..8192 so every size class is exercised. */
+        unsigned shift = 4 + xorshift32() % 9;
+        return (size_t) rand_range((uint64_t) 1 << shift,
+                                   ((uint64_t) 2 << shift) - 1);
+    }
+    }
+}
+
+/* Live objects, kept in a binary min-heap keyed by expiry tick. */
+typedef struct {
+    uint64_t expire;
+    void *ptr;
+} object_t;
+
+static object_t *heap;
+static size_t heap_len, heap_cap;
+
+static bool heap_push(uint64_t expire, void *ptr)
+{
+    if (heap_len == heap_cap) {
+        size_t cap = heap_cap ? heap_cap * 2 : 4096;
+        object_t *n = (object_t *) realloc(heap, cap * sizeof(*heap));
+        if (!n)
+            return false;
+        heap = n;
+        heap_cap = cap;
+    }
+    size_t i = heap_len++;
+    while (i && heap[(i - 1) / 2].expire > expire) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i].expire = expire;
+    heap[i].ptr = ptr;
+    return true;
+}
+
+static void *heap_pop(void)
+{
+    void *ptr = heap[0].ptr;
+    object_t last = heap[--heap_len];
+    size_t i = 0;
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= heap_len)
+            break;
+        if (c + 1 < heap_len && heap[c + 1].expire < heap[c].expire)
+            c++;
+        if (last.expire <= heap[c].expire)
+            break;
+        heap[i] = heap[c];
+        i = c;
+    }
+    if (heap_len)
+        heap[i] = last;
+    return ptr;
+}
+
+static void usage(const char *name)
+{
+    printf(
+        "TLSF fragmentation-over-time benchmark.\n\n"
+        "Usage: %s [options]\n\n"
+        "Options:\n"
+        "  -d minutes   Simulated duration (default: 240)\n"
+        "  -r rate      Allocations per simulated second (default: 100)\n"
+        "  -P minutes   Size phase length (default: 10)\n"
+        "  -L minutes   Maximum long-lived object lifetime (default: 30)\n"
+        "  -S seconds   Sampling interval (default: 60)\n"
+        "  -p bytes     Pool size (default: 25165824)\n"
+        "  -s seed      PRNG seed (default: 1)\n"
+        "  -q           CSV output only\n"
+        "  -h           Show this help\n\n"
+        "Lifetimes: 90%% of objects live 1-5 s, 10%% up to -L minutes.\n",
+        name);
+    exit(1);
+}
+
+static uint64_t parse_arg(const char *arg, const char *exe_name)
+{
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(arg, &end, 0);
+    if (errno || end == arg || *end != '\0')
+        usage(exe_name);
+    return (uint64_t) v;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t minutes = 240, rate = 100, phase_min = 10, long_min = 30;
+    uint64_t sample_sec = 60;
+    size_t pool_size = (size_t) 24 << 20;
+    uint32_t seed = 1;
+    bool quiet = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:r:P:L:S:p:s:qh")) > 0) {
+        switch (opt) {
+        case 'd':
+            minutes = parse_arg(optarg, argv[0]);
+            break;
+        case 'r':
+            rate = parse_arg(optarg, argv[0]);
+            break;
+        case 'P':
+            phase_min = parse_arg(optarg, argv[0]);
+            break;
+        case 'L':
+            long_min = parse_arg(optarg, argv[0]);
+            break;
+        case 'S':
+            sample_sec = parse_arg(optarg, argv[0]);
+            break;
+        case 'p':
+            pool_size = (size_t) parse_arg(optarg, argv[0]);
+            break;
+        case 's':
+            seed = (uint32_t) parse_arg(optarg, argv[0]);
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (!minutes || !rate || !phase_min || !long_min || !sample_sec) {
+        fprintf(stderr, "Error: -d, -r, -P, -L and -S must be > 0\n");
+        return 1;
+    }
+    xorshift_state = seed ? seed : 1;
+
+    void *mem = malloc(pool_size);
+    if (!mem) {
+        fprintf(stderr, "Failed to allocate %zu bytes for pool\n", pool_size);
+        return 1;
+    }
+
+    tlsf_t t;
+    size_t usable = tlsf_pool_init(&t, mem, pool_size);
+    if (!usable) {
+        fprintf(stderr, "tlsf_pool_init failed\n");
+        free(mem);
+        return 1;
+    }
+
+    /* One tick per allocation attempt. */
+    const uint64_t end_tick = minutes * 60 * rate;
+    const uint64_t phase_ticks = phase_min * 60 * rate;
+    const uint64_t sample_ticks = sample_sec * rate;
+    const uint64_t short_lo = rate, short_hi = 5 * rate;
+    const uint64_t long_hi = long_min * 60 * rate;
+
+    char config[32];
+    snprintf(config, sizeof(config), "sl%u-split%u%s%s",
+             (unsigned) _TLSF_SL_COUNT, (unsigned) SPLIT_LABEL, LAYOUT_LABEL,
+             FIT_LABEL);
+
+    if (!quiet) {
+        printf("TLSF fragmentation benchmark: %s\n", config);
+        printf("  Pool: %zu usable bytes, %llu simulated minutes, "
+               "%llu allocs/s\n\n",
+               usable, (unsigned long long) minutes,
+               (unsigned long long) rate);
+    }
+    if (quiet)
+        printf(
+            "config,time_s,phase,live,total_used,total_free,largest_free,"
+            "free_count,frag,fail_rate\n");
+    else
+        printf("  %8s %6s %8s %10s %10s %10s %8s %6s %7s\n", "minute",
+               "phase", "live", "used", "free", "largest", "nfree", "frag",
+               "fail%");
+
+    uint64_t attempts = 0, failures = 0, total_failures = 0;
+    double worst_frag = 0.0;
+
+    for (uint64_t tick = 1; tick <= end_tick; tick++) {
+        while (heap_len && heap[0].expire <= tick)
+            tlsf_free(&t, heap_pop());
+
+        int phase = (int) ((tick / phase_ticks) % PHASE_COUNT);
+        void *p = tlsf_malloc(&t, phase_size(phase));
+        attempts++;
+        if (p) {
+            bool is_long = xorshift32() % 10 == 0;
+            uint64_t life = is_long ? rand_range(short_hi, long_hi)
+                                    : rand_range(short_lo, short_hi);
+            if (!heap_push(tick + life, p)) {
+                fprintf(stderr, "Out of memory for object table\n");
+                return 1;
+            }
+        } else {
+            failures++;
+        }
+
+        if (tick % sample_ticks == 0) {
+            tlsf_stats_t st;
+            tlsf_get_stats(&t, &st);
+            double frag =
+                st.total_free
+                    ? 1.0 - (double) st.largest_free / (double) st.total_free
+                    : 0.0;
+            if (frag > worst_frag)
+                worst_frag = frag;
+            double fail_rate = (double) failures / (double) attempts;
+            if (quiet)
+                printf("%s,%llu,%s,%zu,%zu,%zu,%zu,%zu,%.4f,%.4f\n", config,
+                       (unsigned long long) (tick / rate), phase_name[phase],
+                       heap_len, st.total_used, st.total_free, st.largest_free,
+                       st.free_count, frag, fail_rate);
+            else
+                printf("  %8llu %6s %8zu %10zu %10zu %10zu %8zu %6.3f %7.2f\n",
+                       (unsigned long long) (tick / rate / 60),
+                       phase_name[phase], heap_len, st.total_used,
+                       st.total_free, st.largest_free, st.free_count, frag,
+                       100.0 * fail_rate);
+            total_failures += failures;
+            attempts = failures = 0;
+        }
+    }
+
+    total_failures += failures;
+
+    tlsf_check(&t);
+    if (!quiet)
+        printf("\nTotal failures: %llu of %llu (%.3f%%), worst frag: %.4f\n",
+               (unsigned long long) total_failures,
+               (unsigned long long) end_tick,
+               100.0 * (double) total_failures / (double) end_tick,
+               worst_frag);
+
+    free(heap);
+    free(mem);
+    return 0;
+}
@@ -75,6 +75,7 @@ static void random_test(tlsf_t *t, size_t spacelen, const size_t cap)
                 assert(!((size_t) p[i] % align));
         }
         assert(p[i]);
+        assert(!((size_t) p[i] % ((size_t) 1 << TLSF_ALIGN_SHIFT)));
         rest -= (int64_t) len;
 
         if (rand() % 10 == 0) {
@@ -236,8 +237,10 @@ static void fragmentation_test(tlsf_t *t)
     /*
      * Split into "small" (affected by min block size) and "large" (where
      * SL subdivision is the primary factor). BLOCK_SIZE_SMALL is 256 on
-     * 64-bit with SL=32.
+     * 64-bit with SL=32; a larger TLSF_ALIGN_SHIFT raises it, and large
+     * sizes below it are skipped.
      */
+    const size_t small_limit = (size_t) 1 << _TLSF_FL_SHIFT;
     const size_t small_sizes[] = {17, 31, 33, 47, 63, 65, 95, 127};
     const size_t large_sizes[] = {
         257,  400,  511,  513,   800,   1000,  1500,  2000,  3000,
@@ -245,7 +248,7 @@ static void fragmentation_test(tlsf_t *t)
     };
 
     double small_total = 0.0, large_total = 0.0, large_max = 0.0;
-    size_t large_worst = 0;
+    size_t large_worst = 0, large_tested = 0;
     size_t small_count = sizeof(small_sizes) / sizeof(small_sizes[0]);
     size_t large_count = sizeof(large_sizes) / sizeof(large_sizes[0]);
 
@@ -264,6 +267,9 @@ static void fragmentation_test(tlsf_t *t)
 
     /* Test large sizes (SL subdivision is the limiting factor) */
     for (size_t i = 0; i < large_count; i++) {
+        if (large_sizes[i] < small_limit)
+            continue;
+        large_tested++;
         tlsf_stats_t before, after;
         tlsf_get_stats(t, &before);
         void *ptr = tlsf_malloc(t, large_sizes[i]);
@@ -281,7 +287,7 @@ static void fragmentation_test(tlsf_t *t)
     }
 
     double small_avg = small_total / (double) small_count;
-    double large_avg = large_total / (double) large_count;
+    double large_avg = large_total / (double) large_tested;
 
     printf("  SL subdivisions: %u\n", _TLSF_SL_COUNT);
     printf("  Small sizes (<256B) avg overhead: %.2f%%\n", small_avg);
@@ -290,10 +296,15 @@ static void fragmentation_test(tlsf_t *t)
            large_worst);
 
     /* Validate SL subdivision improvement:
+     * - SL=64: theoretical max 1/64 = 1.56%, allow < 3% for alignment
      * - SL=32: theoretical max 1/32 = 3.125%, allow < 5% for alignment
      * - SL=16: theoretical max 1/16 = 6.25%, allow < 8%
      */
-    if (_TLSF_SL_COUNT == 32) {
+    if (_TLSF_SL_COUNT == 64) {
+        assert(large_max < 3.0 && "large size max overhead exceeds 3%");
+        assert(large_avg < 1.5 && "large size avg overhead exceeds 1.5%");
+        printf("  [PASS] SL=64 validated: max<3%%, avg<1.5%%\n");
+    } else if (_TLSF_SL_COUNT == 32) {
         assert(large_max < 5.0 && "large size max overhead exceeds 5%");
         assert(large_avg < 3.0 && "large size avg overhead exceeds 3%");
         printf("  [PASS] SL=32 validated: max<5%%, avg<3%%\n");
@@ -456,7 +467,11 @@ static void realloc_backward_test(tlsf_t *t)
 
         void *a = tlsf_malloc(t, size_a);
         void *b = tlsf_malloc(t, size_b);
-        assert(a && b);
+        /* C keeps B off the pool end, where a shrink policy may leave free
+         * space to expand forward into.
+         */
+        void *c = tlsf_malloc(t, 64);
+        assert(a && b && c);
 
         memset(b, 0x77, size_b);
         tlsf_free(t, a);
@@ -483,6 +498,38 @@ static void realloc_backward_test(tlsf_t *t)
             assert(data[i] == 0x77);
 
         tlsf_free(t, grown);
+        tlsf_free(t, c);
+        tlsf_check(t);
+    }
+    printf(".");
+    fflush(stdout);
+
+    /* Moves large enough for the streaming copy: backward into an
+     * overlapping range, then a relocation.  Unless TLSF_ALIGN_SHIFT is 6,
+     * the payloads are not cache-line aligned.
+     */
+    {
+        const size_t size_a = 100000, size_b = 3 << 20;
+
+        void *a = tlsf_malloc(t, size_a);
+        uint8_t *b = (uint8_t *) tlsf_malloc(t, size_b);
+        void *c = tlsf_malloc(t, 64);
+        assert(a && b && c);
+        for (size_t i = 0; i < size_b; i++)
+            b[i] = (uint8_t) (i * 7 + (i >> 12));
+        tlsf_free(t, a);
+
+        uint8_t *grown = (uint8_t *) tlsf_realloc(t, b, size_b + 4096);
+        assert(grown == a);
+        for (size_t i = 0; i < size_b; i++)
+            assert(grown[i] == (uint8_t) (i * 7 + (i >> 12)));
+
+        uint8_t *moved = (uint8_t *) tlsf_realloc(t, grown, 2 * size_b);
+        assert(moved && moved != grown);
+        for (size_t i = 0; i < size_b; i++)
+            assert(moved[i] == (uint8_t) (i * 7 + (i >> 12)));
+        tlsf_free(t, c);
+        tlsf_free(t, moved);
         tlsf_check(t);
     }
     printf(". done\n");
@@ -644,7 +691,7 @@ static void static_pool_test(void)
 
     /* Test 8: Append pool extends a static pool */
     {
-        static char combined[8192];
+        static char combined[8192] __attribute__((aligned(64)));
         tlsf_t t;
 
         /* Initialize with first half */
@@ -672,6 +719,57 @@ static void static_pool_test(void)
         tlsf_free(&t, p2);
         tlsf_check(&t);
     }
+    printf(".");
+    fflush(stdout);
+
+    /* Test 9: Blocks taken from a larger free block are trimmed to the
+     * request, not to the minimum of the bin they were found in.
+     */
+    {
+        static char pool[4 * 1024 * 1024];
+        tlsf_t t;
+        tlsf_pool_init(&t, pool, sizeof(pool));
+
+        void *p[3];
+        for (int i = 0; i < 3; i++) {
+            p[i] = tlsf_malloc(&t, 1024);
+            assert(p[i]);
+            assert(tlsf_usable_size(p[i]) < 2048);
+        }
+        assert((char *) p[2] - (char *) p[0] < 3 * 2048);
+
+        /* Large class: within one second-level bin of the request. */
+        void *q = tlsf_malloc(&t, 100000);
+        assert(q);
+        assert(tlsf_usable_size(q) >= 100000);
+        assert(tlsf_usable_size(q) < 100000 + 100000 / 16);
+
+        tlsf_stats_t stats;
+        assert(tlsf_get_stats(&t, &stats) == 0);
+        assert(stats.free_count == 1);
+        assert(stats.total_free > sizeof(pool) - 128 * 1024);
+
+        /* Small fast path: a 32-byte request from a free 256-byte hole. */
+        void *big = tlsf_malloc(&t, 256);
+        void *guard = tlsf_malloc(&t, 64);
+        assert(big && guard);
+        tlsf_free(&t, big);
+        void *s = tlsf_malloc(&t, 32);
+        assert(s == big);
+        assert(tlsf_usable_size(s) <= 64);
+        void *s2 = tlsf_malloc(&t, 32);
+        assert(s2 && (char *) s2 < (char *) guard);
+
+        tlsf_free(&t, s);
+        tlsf_free(&t, s2);
+        tlsf_free(&t, guard);
+        tlsf_free(&t, q);
+        for (int i = 0; i < 3; i++)
+            tlsf_free(&t, p[i]);
+        tlsf_check(&t);
+        assert(tlsf_get_stats(&t, &stats) == 0);
+        assert(stats.free_count == 1);
+    }
     printf(". done\n");
 }
 
@@ -848,7 +946,7 @@ static void pool_reset_test(void)
 
     /* Test 3: Reset after append_pool preserves expanded capacity */
     {
-        static char combined[8192];
+        static char combined[8192] __attribute__((aligned(64)));
         tlsf_t t;
         size_t half = 4096;
         size_t usable = tlsf_pool_init(&t, combined, half);
@@ -888,9 +986,686 @@ static void pool_reset_test(void)
         tlsf_t t = TLSF_INIT;
         tlsf_pool_reset(&t); /* arena is NULL, no-op */
     }
+    printf(".");
+    fflush(stdout);
+
+    /* Test 5: Neither init nor reset writes the bin heads, so a control
+     * structure full of garbage, then one with stale heads left by freed
+     * blocks of many sizes, must behave like a clean one.
+     */
+    {
+        static char pool[256 * 1024];
+        tlsf_t t;
+        memset(&t, 0xA5, sizeof(t));
+        size_t usable = tlsf_pool_init(&t, pool, sizeof(pool));
+        assert(usable > 0);
+        tlsf_check(&t);
+
+        for (int round = 0; round < 3; round++) {
+            void *ptrs[64];
+            for (int i = 0; i < 64; i++) {
+                ptrs[i] = tlsf_malloc(&t, 16 + (size_t) i * 97);
+                assert(ptrs[i]);
+            }
+            /* Free every other block, leaving many bins populated */
+            for (int i = 0; i < 64; i += 2)
+                tlsf_free(&t, ptrs[i]);
+            tlsf_check(&t);
+
+            tlsf_pool_reset(&t);
+            tlsf_check(&t);
+
+            tlsf_stats_t stats;
+            tlsf_get_stats(&t, &stats);
+            assert(stats.free_count == 1);
+            assert(stats.total_free == usable);
+        }
+    }
+    printf(". done\n");
+}
+
+/* Test the free-block histogram against the full heap walk. */
+static void histogram_test(tlsf_t *t)
+{
+    printf("Histogram test: ");
+    fflush(stdout);
+
+    static tlsf_histogram_t hist;
+
+    /* Fresh static pool: one free block, no fragmentation */
+    {
+        static char pool[1024 * 64];
+        tlsf_t s;
+        size_t usable = tlsf_pool_init(&s, pool, sizeof(pool));
+        assert(usable > 0);
+
+        assert(tlsf_get_histogram(&s, &hist) == 0);
+        assert(hist.free_count == 1);
+        assert(hist.total_free == usable);
+        assert(hist.largest_free == usable);
+        assert(hist.frag == 0);
+    }
+    printf(".");
+    fflush(stdout);
+
+    /* Checkerboard: free every other block to create holes */
+    void *ptrs[64];
+    for (int i = 0; i < 64; i++) {
+        ptrs[i] = tlsf_malloc(t, 24 + (size_t) i * 16);
+        assert(ptrs[i]);
+    }
+    for (int i = 0; i < 64; i += 2)
+        tlsf_free(t, ptrs[i]);
+    tlsf_check(t);
+
+    tlsf_stats_t stats;
+    assert(tlsf_get_stats(t, &stats) == 0);
+    assert(tlsf_get_histogram(t, &hist) == 0);
+    assert(hist.free_count == stats.free_count);
+    assert(hist.total_free == stats.total_free);
+    assert(hist.largest_free == stats.largest_free);
+    assert(hist.free_count > 1);
+    assert(hist.frag > 0 && hist.frag < 1000);
+
+    /* Per-bin totals add up, and every block sits in a matching bin */
+    size_t count = 0, bytes = 0;
+    for (uint32_t i = 0; i < _TLSF_FL_COUNT; i++) {
+        for (uint32_t j = 0; j < _TLSF_SL_COUNT; j++) {
+            count += hist.count[i][j];
+            bytes += hist.bytes[i][j];
+            if (hist.count[i][j])
+                assert(hist.bytes[i][j] >=
+                       hist.count[i][j] * tlsf_bin_size(i, j));
+        }
+    }
+    assert(count == hist.free_count);
+    assert(bytes == hist.total_free);
+
+    /* Class fragmentation is monotonic in the class index */
+    assert(hist.class_frag[0] == 0);
+    for (uint32_t i = 1; i < _TLSF_FL_COUNT; i++)
+        assert(hist.class_frag[i] >= hist.class_frag[i - 1]);
+
+    for (int i = 1; i < 64; i += 2)
+        tlsf_free(t, ptrs[i]);
+    tlsf_check(t);
+    printf(".");
+    fflush(stdout);
+
+    /* Empty dynamic pool and invalid arguments */
+    tlsf_t empty = TLSF_INIT;
+    assert(tlsf_get_histogram(&empty, &hist) == 0);
+    assert(hist.free_count == 0 && hist.frag == 0);
+    assert(tlsf_get_histogram(NULL, &hist) == -1);
+    assert(tlsf_get_histogram(t, NULL) == -1);
+    assert(tlsf_bin_size(_TLSF_FL_COUNT, 0) == 0);
+    printf(". done\n");
+}
+
+/* Rebuild a pool's control structure from a copy of its arena. */
+static void rebuild_test(tlsf_t *t)
+{
+    printf("Rebuild test: ");
+    fflush(stdout);
+
+    char *p[4];
+    for (int i = 0; i < 4; i++) {
+        p[i] = (char *) tlsf_malloc(t, 100 + (size_t) i * 50);
+        assert(p[i]);
+        memset(p[i], 'a' + i, 100);
+    }
+
+    /* Clone: copy the arena only, then rebuild at the new address. */
+    char *arena = (char *) tlsf_resize(t, t->size);
+    char *clone;
+    assert(!posix_memalign((void **) &clone, 64, t->size));
+    memcpy(clone, arena, t->size);
+    char *pristine = (char *) malloc(t->size);
+    assert(pristine);
+    memcpy(pristine, arena, t->size);
+
+    tlsf_t r;
+    memset(&r, 0xa5, sizeof(r));
+    assert(tlsf_rebuild(&r, clone, t->size) == 0);
+    tlsf_check(&r);
+    tlsf_stats_t orig, copy;
+    assert(tlsf_get_stats(t, &orig) == 0);
+    assert(tlsf_get_stats(&r, &copy) == 0);
+    assert(copy.total_used == orig.total_used);
+    assert(copy.free_count == orig.free_count);
+    printf(".");
+    fflush(stdout);
+
+    /* Mark p[0] and p[1] free by hand, as if a free was interrupted
+     * before coalescing: rebuild must merge them.
+     */
+    char *q[4];
+    for (int i = 0; i < 4; i++)
+        q[i] = clone + (p[i] - arena);
+    size_t lost = tlsf_usable_size(q[0]) + tlsf_usable_size(q[1]);
+    ((size_t *) q[0])[-1] |= 1;
+    ((size_t *) q[1])[-1] |= 1;
+    assert(tlsf_rebuild(&r, clone, t->size) == 0);
+    tlsf_check(&r);
+    assert(tlsf_get_stats(&r, &copy) == 0);
+    assert(copy.total_used == orig.total_used - lost);
+    assert(q[2][0] == 'c' && q[3][99] == 'd');
+    tlsf_free(&r, q[2]);
+    tlsf_free(&r, q[3]);
+    tlsf_check(&r);
+    assert(tlsf_get_stats(&r, &copy) == 0);
+    assert(copy.free_count == 1 && copy.total_used == 0);
+    printf(".");
+    fflush(stdout);
+
+    /* In place, dynamic: the pool keeps growing through tlsf_resize(). */
+    size_t size = t->size;
+    memset(t, 0xa5, sizeof(*t));
+    assert(tlsf_rebuild(t, NULL, size) == 0);
+    tlsf_check(t);
+    assert(tlsf_get_stats(t, &copy) == 0);
+    assert(copy.total_used == orig.total_used);
+    void *big = tlsf_malloc(t, size);
+    assert(big);
+    tlsf_free(t, big);
+    printf(".");
+    fflush(stdout);
+
+    /* Malformed chains and arguments leave r and the pool untouched.
+     * Work on a fresh copy: the free blocks of clone are poisoned under
+     * ASAN now that r owns it.
+     */
+    free(clone);
+    char *bad;
+    assert(!posix_memalign((void **) &bad, 64, size));
+    memcpy(bad, pristine, size);
+    tlsf_t saved_r = r;
+    assert(tlsf_rebuild(&r, bad, size + 64) == -1);
+    assert(!memcmp(&r, &saved_r, sizeof(r)));
+    assert(tlsf_rebuild(&r, bad + 1, size) == -1);
+    assert(tlsf_rebuild(NULL, bad, size) == -1);
+
+    /* A free run before a bad header is not merged: the chain is checked
+     * before anything is written.  A size that is not a multiple of the
+     * alignment is bad even when it stays inside the pool.
+     */
+    for (int i = 0; i < 4; i++)
+        q[i] = bad + (p[i] - arena);
+    ((size_t *) q[0])[-1] |= 1;
+    ((size_t *) q[1])[-1] |= 1;
+    memcpy(pristine, bad, size);
+#ifdef TLSF_PROFILE
+    const size_t misalign = 8; /* Bit 2 is the sampled flag */
+#else
+    const size_t misalign = 4;
+#endif
+    if (misalign < _TLSF_ALIGN_SIZE) {
+        ((size_t *) q[2])[-1] += misalign;
+        assert(tlsf_rebuild(&r, bad, size) == -1);
+        ((size_t *) q[2])[-1] -= misalign;
+        assert(!memcmp(bad, pristine, size));
+        assert(!memcmp(&r, &saved_r, sizeof(r)));
+    }
+    /* A block running past the sentinel */
+    ((size_t *) q[3])[-1] += size;
+    assert(tlsf_rebuild(&r, bad, size) == -1);
+    ((size_t *) q[3])[-1] -= size;
+    assert(!memcmp(bad, pristine, size));
+    assert(!memcmp(&r, &saved_r, sizeof(r)));
+    free(pristine);
+    free(bad);
+
+    for (int i = 0; i < 4; i++)
+        tlsf_free(t, p[i]);
+    tlsf_check(t);
+    printf(". done\n");
+}
+
+/* In a nearly full pool, an aligned request fits a free block that is
+ * already aligned, without the align - 1 + header bytes of worst-case
+ * padding.
+ */
+static void aligned_fit_test(void)
+{
+    printf("Aligned fit test: ");
+    fflush(stdout);
+
+    static char pool[64 * 1024] __attribute__((aligned(4096)));
+    tlsf_t t;
+    tlsf_pool_init(&t, pool, sizeof(pool));
+
+    const size_t aligns[] = {64, 4096};
+    for (size_t i = 0; i < sizeof(aligns) / sizeof(aligns[0]); i++) {
+        const size_t align = aligns[i], size = align < 256 ? 256 : align;
+
+        char *q = (char *) tlsf_aalloc(&t, align, size);
+        assert(q && !((uintptr_t) q & (align - 1)));
+
+        /* Fill everything else, down to the smallest blocks. */
+        enum { MAX_FILL = 4096 };
+        static void *fill[MAX_FILL];
+        int n = 0;
+        for (size_t sz = 8192; sz >= 8; sz /= 2) {
+            while (n < MAX_FILL && (fill[n] = tlsf_malloc(&t, sz)))
+                n++;
+        }
+        assert(n < MAX_FILL);
+
+        tlsf_free(&t, q);
+        tlsf_stats_t stats;
+        assert(tlsf_get_stats(&t, &stats) == 0);
+        assert(stats.largest_free < size + align);
+
+        char *r = (char *) tlsf_aalloc(&t, align, size);
+        assert(r == q);
+        tlsf_free(&t, r);
+        for (int j = 0; j < n; j++)
+            tlsf_free(&t, fill[j]);
+        tlsf_check(&t);
+        printf(".");
+        fflush(stdout);
+    }
+    printf(" done\n");
+}
+
+/* Count the resident pages of [p, p + len); p is page-aligned. */
+static size_t resident_pages(const void *p, size_t len)
+{
+    size_t pages = (len + PAGE - 1) / PAGE, n = 0;
+    unsigned char *vec = (unsigned char *) malloc(pages);
+    assert(vec);
+    assert(!mincore((void *) (uintptr_t) p, len, vec));
+    for (size_t i = 0; i < pages; i++)
+        n += vec[i] & 1;
+    free(vec);
+    return n;
+}
+
+/* tlsf_pool_prefault() makes every page of the pool resident without
+ * changing a byte of it, for static and dynamic pools.
+ */
+static void prefault_test(tlsf_t *t)
+{
+    printf("Prefault test: ");
+    fflush(stdout);
+
+    assert(tlsf_pool_prefault(NULL, 0) == -1);
+
+    /* Static pool in fresh anonymous memory */
+    {
+        const size_t size = 64 * PAGE;
+        char *mem = (char *) mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        assert(mem != MAP_FAILED);
+        tlsf_t s;
+        assert(tlsf_pool_init(&s, mem, size));
+        char *p = (char *) tlsf_malloc(&s, 100);
+        assert(p);
+        memset(p, 0x5A, 100);
+        /* Drop pages inside the free block, which TLSF_ENABLE_POISON
+         * has filled.
+         */
+        assert(!madvise(mem + 2 * PAGE, 60 * PAGE, MADV_DONTNEED));
+        assert(resident_pages(mem, size) < 64);
+
+        assert(tlsf_pool_prefault(&s, 0) == 0);
+        assert(resident_pages(mem, size) == 64);
+        for (int i = 0; i < 100; i++)
+            assert(p[i] == 0x5A);
+        tlsf_check(&s);
+
+        /* Locking may exceed RLIMIT_MEMLOCK; it must not break the pool. */
+        if (tlsf_pool_prefault(&s, TLSF_PREFAULT_LOCK) == 0)
+            assert(!munlock(mem, size));
+        tlsf_free(&s, p);
+        tlsf_check(&s);
+        munmap(mem, size);
+    }
+    printf(".");
+    fflush(stdout);
+
+    /* Dynamic pool: drop the pages inside a large block, as if the pool
+     * had just grown into fresh memory.
+     */
+    {
+        char *p = (char *) tlsf_malloc(t, 32 * PAGE);
+        assert(p);
+        char *first = (char *) (((uintptr_t) p + PAGE - 1) & ~(PAGE - 1));
+        assert(!madvise(first, 30 * PAGE, MADV_DONTNEED));
+        size_t size = t->size;
+        assert(resident_pages(start_addr, size) < (size + PAGE - 1) / PAGE);
+
+        assert(tlsf_pool_prefault(t, 0) == 0);
+        assert(resident_pages(start_addr, size) == (size + PAGE - 1) / PAGE);
+        tlsf_free(t, p);
+        tlsf_check(t);
+    }
+    printf(". done\n");
+}
+
+/* tlsf_reserve() carves blocks that later allocations of that size take
+ * without splitting anything else, and that return to their bin when
+ * freed instead of coalescing, until tlsf_unreserve().
+ */
+static void reserve_test(tlsf_t *t)
+{
+    printf("Reserve test: ");
+    fflush(stdout);
+
+    assert(!tlsf_reserve(NULL, 64, 1));
+    tlsf_unreserve(NULL, NULL);
+
+    const size_t sizes[] = {1, 100, 3000, 70000};
+    for (size_t k = 0; k < ARRAY_SIZE(sizes); k++) {
+        static char pool[4 * 1024 * 1024];
+        tlsf_t s;
+        tlsf_pool_init(&s, pool, sizeof(pool));
+        assert(!tlsf_reserve(&s, sizes[k], 0));
+        tlsf_unreserve(&s, NULL);
+
+        /* The run is cut right after pre.  Freeing pre must not take the
+         * first reserved block out of its bin.
+         */
+        tlsf_stats_t before, stats;
+        void *pre = tlsf_malloc(&s, 64);
+        assert(pre);
+        void *r = tlsf_reserve(&s, sizes[k], 16);
+        assert(r);
+        tlsf_free(&s, pre);
+        tlsf_check(&s);
+        tlsf_get_stats(&s, &before);
+        assert(before.free_count == 18);
+
+        void *p[16];
+        for (int round = 0; round < 2; round++) {
+            for (int i = 0; i < 16; i++) {
+                p[i] = tlsf_malloc(&s, sizes[k]);
+                assert(p[i]);
+                memset(p[i], i, sizes[k]);
+            }
+            /* Only the reserved blocks were used */
+            tlsf_get_stats(&s, &stats);
+            assert(stats.free_count == 2);
+            assert(stats.largest_free == before.largest_free);
+            tlsf_check(&s);
+
+            for (int i = 0; i < 16; i++)
+                tlsf_free(&s, p[i]);
+            tlsf_get_stats(&s, &stats);
+            assert(stats.free_count == before.free_count);
+            assert(stats.total_free == before.total_free);
+            tlsf_check(&s);
+        }
+
+        /* A run larger than any free block fails and changes nothing */
+        assert(!tlsf_reserve(&s, sizeof(pool) / 4, 8));
+        tlsf_get_stats(&s, &stats);
+        assert(stats.free_count == before.free_count);
+        assert(stats.total_free == before.total_free);
+
+        /* Unreserved, blocks still in use coalesce once freed */
+        for (int i = 0; i < 16; i++)
+            assert((p[i] = tlsf_malloc(&s, sizes[k])));
+        tlsf_unreserve(&s, r);
+        tlsf_check(&s);
+        for (int i = 0; i < 16; i++)
+            tlsf_free(&s, p[i]);
+        tlsf_check(&s);
+        tlsf_get_stats(&s, &stats);
+        assert(stats.free_count == 1 && stats.total_used == 0);
+
+        /* Reset drops a reservation too */
+        assert(tlsf_reserve(&s, sizes[k], 16));
+        tlsf_pool_reset(&s);
+        tlsf_get_stats(&s, &stats);
+        assert(stats.free_count == 1);
+        printf(".");
+        fflush(stdout);
+    }
+
+    /* A dynamic pool grows to hold the run.  Free reserved blocks
+     * coalesce as soon as the fences go.
+     */
+    {
+        tlsf_stats_t before, stats;
+        tlsf_get_stats(t, &before);
+        void *r = tlsf_reserve(t, 200, 8);
+        assert(r);
+        tlsf_check(t);
+        void *p[8];
+        for (int i = 0; i < 8; i++) {
+            p[i] = tlsf_malloc(t, 200);
+            assert(p[i]);
+        }
+        for (int i = 0; i < 8; i++)
+            tlsf_free(t, p[i]);
+        tlsf_check(t);
+        tlsf_unreserve(t, r);
+        tlsf_check(t);
+        tlsf_get_stats(t, &stats);
+        assert(stats.total_used == before.total_used);
+        assert(stats.free_count <= before.free_count + 1);
+    }
+    printf(". done\n");
+}
+
+/* tlsf_try_expand() grows into the next free block only, never moves the
+ * payload, and reports the same size tlsf_usable_size() does.
+ */
+static void try_expand_test(void)
+{
+    printf("In-place expansion test: ");
+    fflush(stdout);
+
+    static char pool[64 * 1024] __attribute__((aligned(64)));
+    tlsf_t t;
+    tlsf_pool_init(&t, pool, sizeof(pool));
+
+    size_t cap;
+    char *lo = (char *) tlsf_malloc_usable(&t, 200, &cap);
+    assert(lo && cap >= 200 && cap == tlsf_usable_size(lo));
+    char *a = (char *) tlsf_malloc_usable(&t, 100, &cap);
+    assert(a && cap >= 100 && cap == tlsf_usable_size(a));
+    void *b = tlsf_malloc(&t, 1000);
+    void *guard = tlsf_malloc(&t, 64);
+    assert(b && guard);
+    memset(a, 0x5A, cap);
+
+    /* Next block used: nothing to grow into, even with prev free. */
+    tlsf_free(&t, lo);
+    assert(tlsf_try_expand(&t, a, cap + 1, cap + 1) == 0);
+    assert(tlsf_usable_size(a) == cap);
+    /* Already large enough: unchanged. */
+    assert(tlsf_try_expand(&t, a, cap, cap) == cap);
+    assert(tlsf_try_expand(&t, a, 1, 0) == cap);
+    assert(tlsf_try_expand(&t, NULL, 1, 1) == 0);
+
+    /* Preferred size fits: grow to it, return the surplus. */
+    tlsf_free(&t, b);
+    size_t got = tlsf_try_expand(&t, a, cap + 1, cap + 200);
+    assert(got >= cap + 200 && got < cap + 200 + 64);
+    assert(got == tlsf_usable_size(a));
+    for (size_t i = 0; i < cap; i++)
+        assert(a[i] == 0x5A);
+    tlsf_check(&t);
+
+    /* Preferred out of reach but min within: take the whole neighbour. */
+    size_t all = tlsf_try_expand(&t, a, got + 1, TLSF_MAX_SIZE + 1);
+    assert(all > got && all == tlsf_usable_size(a));
+    assert(tlsf_try_expand(&t, a, all + 1, all + 1) == 0);
+    assert(tlsf_usable_size(a) == all);
+    /* Preferred below min counts as min. */
+    tlsf_free(&t, guard);
+    size_t more = tlsf_try_expand(&t, a, all + 8, 0);
+    assert(more >= all + 8 && more < all + 8 + 64);
+    for (size_t i = 0; i < cap; i++)
+        assert(a[i] == 0x5A);
+    tlsf_check(&t);
+
+    /* Out of reach min leaves the pool alone. */
+    assert(tlsf_try_expand(&t, a, sizeof(pool), sizeof(pool)) == 0);
+    assert(tlsf_usable_size(a) == more);
+    tlsf_free(&t, a);
+    tlsf_check(&t);
+
+    assert(!tlsf_malloc_usable(&t, sizeof(pool), &cap) && cap == 0);
+    assert(tlsf_malloc_usable(&t, 1, NULL));
+    printf("done\n");
+}
+
+/* A free block in the bin of the request, but below its rounded size, is
+ * only used with TLSF_GOOD_FIT, and only within the first TLSF_GOOD_FIT
+ * blocks of that bin.
+ */
+static void good_fit_test(void)
+{
+    printf("Good-fit test: ");
+    fflush(stdout);
+
+    static char pool[1024 * 1024] __attribute__((aligned(64)));
+    tlsf_t t;
+    tlsf_pool_init(&t, pool, sizeof(pool));
+
+    /* Per-block overhead, from two neighbours carved off a fresh pool. */
+    char *a = (char *) tlsf_malloc(&t, 64);
+    char *b = (char *) tlsf_malloc(&t, 64);
+    assert(a && b);
+    const size_t overhead = (size_t) (b - a) - tlsf_usable_size(a);
+    tlsf_free(&t, b);
+    tlsf_free(&t, a);
+
+    /* The shrink leaves a HOLE-byte hole in the bin starting at 64 KB.
+     * That bin is at least 1 KB wide for every SL count and alignment,
+     * so HOLE is below the next boundary, where a rounded HOLE-byte
+     * request starts searching.
+     */
+    enum { BIG = 128 * 1024, HOLE = 64 * 1024 + 64 };
+    const size_t keep = BIG - HOLE - overhead;
+    a = (char *) tlsf_malloc(&t, BIG);
+    void *guard = tlsf_malloc(&t, 64);
+    assert(a && guard);
+    assert(tlsf_realloc(&t, a, keep) == a);
+    assert(tlsf_usable_size(a) == keep);
+    char *hole = a + keep + overhead;
+
+    void *p = tlsf_malloc(&t, HOLE);
+    assert(p);
+#if defined(TLSF_GOOD_FIT) && TLSF_GOOD_FIT > 0
+    assert(p == hole);
+    assert(tlsf_usable_size(p) == HOLE);
+#else
+    assert(p != hole);
+#endif
+    tlsf_free(&t, p);
+    tlsf_free(&t, a);
+    tlsf_free(&t, guard);
+    tlsf_check(&t);
+    printf(".");
+    fflush(stdout);
+
+#if defined(TLSF_GOOD_FIT) && TLSF_GOOD_FIT > 0
+    /* The fitting block sits behind K blocks that are too small. */
+    for (int k = TLSF_GOOD_FIT - 1; k <= TLSF_GOOD_FIT; k++) {
+        void *blk[2 * (TLSF_GOOD_FIT + 1)];
+        blk[0] = tlsf_malloc(&t, HOLE);
+        blk[1] = tlsf_malloc(&t, 64);
+        for (int i = 1; i <= k; i++) {
+            blk[2 * i] = tlsf_malloc(&t, 64 * 1024);
+            blk[2 * i + 1] = tlsf_malloc(&t, 64);
+        }
+        for (int i = 0; i <= 2 * k + 1; i++)
+            assert(blk[i]);
+        /* Free lists are LIFO: the HOLE-byte block ends up last. */
+        for (int i = 0; i <= k; i++)
+            tlsf_free(&t, blk[2 * i]);
+
+        p = tlsf_malloc(&t, HOLE);
+        assert(p);
+        if (k < TLSF_GOOD_FIT)
+            assert(p == blk[0]);
+        else
+            assert(p != blk[0]);
+        tlsf_free(&t, p);
+        for (int i = 0; i <= k; i++)
+            tlsf_free(&t, blk[2 * i + 1]);
+        tlsf_check(&t);
+        tlsf_stats_t stats;
+        assert(tlsf_get_stats(&t, &stats) == 0);
+        assert(stats.free_count == 1);
+    }
+#endif
     printf(". done\n");
 }
 
+/* tlsf_free_batch() leaves the pool exactly as freeing one by one does. */
+static void free_batch_test(tlsf_t *t)
+{
+    printf("Batch free test: ");
+    fflush(stdout);
+
+    enum { N = 256 };
+    static void *p[N + 1], *q[N + 1], *batch[N + N / 7 + 1];
+    for (int i = 0; i <= N; i++) {
+        p[i] = tlsf_malloc(t, 16 + (size_t) (rand() % 2000));
+        assert(p[i]);
+    }
+
+    /* Twin pool: a static copy of the arena.  p[N] stays allocated so the
+     * dynamic pool never shrinks and both stay comparable.
+     */
+    char *arena = (char *) tlsf_resize(t, t->size);
+    char *clone;
+    assert(!posix_memalign((void **) &clone, 64, t->size));
+    memcpy(clone, arena, t->size);
+    tlsf_t r;
+    assert(tlsf_rebuild(&r, clone, t->size) == 0);
+    for (int i = 0; i <= N; i++)
+        q[i] = clone + ((char *) p[i] - arena);
+
+    /* Shuffled, with NULL holes, in two rounds: the first leaves many
+     * free neighbours behind for the second to merge with.
+     */
+    for (int round = 0; round < 2; round++) {
+        size_t n = 0;
+        int order[N];
+        for (int i = 0; i < N; i++)
+            order[i] = i;
+        for (int i = N - 1; i > 0; i--) {
+            int j = rand() % (i + 1), tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+        }
+        for (int k = 0; k < N; k++) {
+            int i = order[k];
+            if (!p[i] || (round == 0 && (i % 3)))
+                continue;
+            batch[n++] = p[i];
+            tlsf_free(&r, q[i]);
+            p[i] = q[i] = NULL;
+            if (n % 7 == 0)
+                batch[n++] = NULL;
+        }
+        tlsf_free_batch(t, batch, n);
+        tlsf_check(t);
+        tlsf_check(&r);
+
+        static tlsf_histogram_t ht, hr;
+        assert(tlsf_get_histogram(t, &ht) == 0);
+        assert(tlsf_get_histogram(&r, &hr) == 0);
+        assert(ht.free_count == hr.free_count);
+        assert(ht.total_free == hr.total_free);
+        assert(!memcmp(ht.count, hr.count, sizeof(ht.count)));
+        printf(".");
+        fflush(stdout);
+    }
+
+    tlsf_free_batch(t, NULL, 0);
+    tlsf_free_batch(t, &p[N], 1);
+    tlsf_check(t);
+    free(clone);
+    printf(" done\n");
+}
+
 int main(void)
 {
     PAGE = (size_t) sysconf(_SC_PAGESIZE);
@@ -933,6 +1708,30 @@ int main(void)
     /* Run pool reset test */
     pool_reset_test();
 
+    /* Run free-block histogram test */
+    histogram_test(&t);
+
+    /* Run control-structure rebuild test */
+    rebuild_test(&t);
+
+    /* Run batched free test */
+    free_batch_test(&t);
+
+    /* Run good-fit search test */
+    good_fit_test();
+
+    /* Run aligned allocation fit test */
+    aligned_fit_test();
+
+    /* Run in-place expansion test */
+    try_expand_test();
+
+    /* Run prefault test */
+    prefault_test(&t);
+
+    /* Run reservation test */
+    reserve_test(&t);
+
     puts("OK!");
     return 0;
 }
@@ -0,0 +1,183 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * Latency histogram test (TLSF_LATENCY).
+ *
+ * Checks the log-linear bucket mapping, that every public call on a pool
+ * lands in exactly one histogram row (internal calls made by realloc and
+ * aalloc are not double counted), percentile queries, and that the
+ * thread wrapper charges each call once and records its lock waits.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tlsf_thread.h"
+
+#define ARENA_SIZE (16 * 1024 * 1024)
+#define NUM_THREADS 4
+#define OPS_PER_THREAD 20000
+
+static char arena[ARENA_SIZE] __attribute__((aligned(16)));
+
+void *tlsf_resize(tlsf_t *t, size_t req_size)
+{
+    (void) t;
+    return req_size <= ARENA_SIZE ? arena : NULL;
+}
+
+static uint64_t row_sum(const tlsf_latency_t *lat, unsigned op)
+{
+    uint64_t n = 0;
+    for (unsigned b = 0; b < TLSF_LAT_BUCKETS; b++)
+        n += lat->count[op][b];
+    return n;
+}
+
+static void bucket_test(void)
+{
+    for (unsigned b = 0; b + 1 < TLSF_LAT_BUCKETS; b++) {
+        uint64_t lo = tlsf_latency_bucket_min(b);
+        uint64_t hi = tlsf_latency_bucket_min(b + 1);
+        assert(lo < hi);
+        assert(tlsf_latency_bucket(lo) == b);
+        assert(tlsf_latency_bucket(hi - 1) == b);
+        /* Width at most a quarter of the lower bound past the exact ones */
+        if (lo >= 4)
+            assert((hi - lo) * 4 <= lo);
+    }
+    assert(tlsf_latency_bucket(0) == 0);
+    assert(tlsf_latency_bucket(UINT64_MAX) == TLSF_LAT_BUCKETS - 1);
+    printf("Bucket mapping test: done\n");
+}
+
+static void pool_test(void)
+{
+    tlsf_t t = TLSF_INIT;
+    static void *p[1500];
+
+    for (int i = 0; i < 1000; i++)
+        assert((p[i] = tlsf_malloc(&t, (size_t) (16 + i * 8))));
+    for (int i = 1000; i < 1500; i++)
+        assert((p[i] = tlsf_aalloc(&t, 64, 100)));
+    /* Growing every other block forces relocations through malloc/free */
+    for (int i = 0; i < 300; i++)
+        assert((p[i * 2] = tlsf_realloc(&t, p[i * 2], 20000)));
+    for (int i = 0; i < 1500; i++)
+        tlsf_free(&t, p[i]);
+    tlsf_free(&t, NULL);
+
+    tlsf_latency_t lat;
+    assert(tlsf_get_latency(&t, &lat, true) == 0);
+    assert(row_sum(&lat, TLSF_LAT_MALLOC) == 1000);
+    assert(row_sum(&lat, TLSF_LAT_AALLOC) == 500);
+    assert(row_sum(&lat, TLSF_LAT_REALLOC) == 300);
+    assert(row_sum(&lat, TLSF_LAT_FREE) == 1500);
+    assert(row_sum(&lat, TLSF_LAT_LOCK) == 0);
+
+    for (unsigned op = 0; op < TLSF_LAT_LOCK; op++) {
+        uint64_t p50 = tlsf_latency_percentile(&lat, op, 500);
+        uint64_t p99 = tlsf_latency_percentile(&lat, op, 990);
+        uint64_t max = tlsf_latency_percentile(&lat, op, 1000);
+        assert(p50 && p50 <= p99 && p99 <= max);
+    }
+    printf("  malloc p50 %llu p99 %llu ticks\n",
+           (unsigned long long) tlsf_latency_percentile(&lat, 0, 500),
+           (unsigned long long) tlsf_latency_percentile(&lat, 0, 990));
+    assert(!tlsf_latency_percentile(&lat, TLSF_LAT_LOCK, 500));
+    assert(!tlsf_latency_percentile(&lat, TLSF_LAT_OPS, 500));
+
+    /* The reset left the pool's histograms empty. */
+    assert(tlsf_get_latency(&t, &lat, false) == 0);
+    for (unsigned op = 0; op < TLSF_LAT_OPS; op++)
+        assert(!row_sum(&lat, op));
+    assert(tlsf_get_latency(NULL, &lat, false) == -1);
+    printf("Pool histogram test: done\n");
+}
+
+static tlsf_thread_t ts;
+
+typedef struct {
+    unsigned seed;
+    uint64_t mallocs, reallocs, frees;
+} worker_t;
+
+static void *worker(void *arg)
+{
+    worker_t *w = (worker_t *) arg;
+    for (int i = 0; i < OPS_PER_THREAD; i++) {
+        w->seed = w->seed * 1103515245u + 12345u;
+        char *q = (char *) tlsf_thread_malloc(&ts, 32 + (w->seed >> 20) % 512);
+        if (!q)
+            continue;
+        w->mallocs++;
+        char *r = (char *) tlsf_thread_realloc(&ts, q, 1024);
+        if (r) {
+            w->reallocs++;
+            q = r;
+        }
+        tlsf_thread_free(&ts, q);
+        w->frees++;
+    }
+    return NULL;
+}
+
+static void thread_test(void)
+{
+    assert(tlsf_thread_init(&ts, arena, sizeof(arena)));
+    pthread_t th[NUM_THREADS];
+    worker_t w[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; i++) {
+        memset(&w[i], 0, sizeof(w[i]));
+        w[i].seed = (unsigned) i + 1;
+        assert(!pthread_create(&th[i], NULL, worker, &w[i]));
+    }
+    uint64_t mallocs = 0, reallocs = 0, frees = 0;
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_join(th[i], NULL);
+        mallocs += w[i].mallocs;
+        reallocs += w[i].reallocs;
+        frees += w[i].frees;
+    }
+    assert(mallocs > 0);
+
+    /* Each successful call is charged once, to the arena that served it. */
+    tlsf_latency_t all, one, sum;
+    assert(tlsf_thread_latency(&ts, -1, &all, false) == 0);
+    assert(row_sum(&all, TLSF_LAT_MALLOC) == mallocs);
+    assert(row_sum(&all, TLSF_LAT_REALLOC) == reallocs);
+    assert(row_sum(&all, TLSF_LAT_FREE) == frees);
+    assert(row_sum(&all, TLSF_LAT_LOCK) >= mallocs + reallocs + frees);
+
+    memset(&sum, 0, sizeof(sum));
+    for (int a = 0; a < ts.count; a++) {
+        assert(tlsf_thread_latency(&ts, a, &one, true) == 0);
+        for (unsigned op = 0; op < TLSF_LAT_OPS; op++)
+            for (unsigned b = 0; b < TLSF_LAT_BUCKETS; b++)
+                sum.count[op][b] += one.count[op][b];
+
+        /* The pool underneath saw at least the calls the arena served. */
+        tlsf_latency_t pool;
+        assert(tlsf_get_latency(&ts.arenas[a].pool, &pool, false) == 0);
+        assert(row_sum(&pool, TLSF_LAT_MALLOC) >=
+               row_sum(&one, TLSF_LAT_MALLOC));
+        assert(row_sum(&pool, TLSF_LAT_FREE) >= row_sum(&one, TLSF_LAT_FREE));
+    }
+    assert(!memcmp(&sum, &all, sizeof(sum)));
+    assert(tlsf_thread_latency(&ts, ts.count, &one, false) == -1);
+    assert(tlsf_thread_latency(&ts, -1, &all, false) == 0);
+    assert(!row_sum(&all, TLSF_LAT_MALLOC));
+
+    tlsf_thread_destroy(&ts);
+    printf("Thread wrapper histogram test: done\n");
+}
+
+int main(void)
+{
+    bucket_test();
+    pool_test();
+    thread_test();
+    printf("OK!\n");
+    return 0;
+}
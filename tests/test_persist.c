@@ -0,0 +1,204 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * Persistent heap test.
+ *
+ * Drives one heap file through the open paths of tlsf_pool_open():
+ *   - create, clean close, O(1) resume with pointers still valid
+ *   - crash (child exits without closing), rebuild from the block chain
+ *   - relocation when the recorded address range is occupied
+ *   - damaged block chain rejected, header left intact for a retry
+ * tlsf_rebuild() itself is covered by tests/test.c.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "tlsf_persist.h"
+
+#define HEAP_SIZE (4 * 1024 * 1024)
+#define NUM_NODES 100
+
+/* A list hanging off the heap root; links are raw pointers, so they
+ * survive only when the heap comes back at the same address.
+ */
+typedef struct node {
+    struct node *next;
+    uint32_t value;
+} node_t;
+
+static char path[64];
+static uint32_t num_nodes; /* Nodes that fit in the pool */
+
+static void build_list(tlsf_persist_t *p)
+{
+    node_t *head = NULL;
+    for (num_nodes = 0; num_nodes < NUM_NODES; num_nodes++) {
+        node_t *n = (node_t *) tlsf_malloc(p->tlsf, sizeof(*n));
+        if (!n)
+            break;
+        n->value = num_nodes;
+        n->next = head;
+        head = n;
+    }
+    assert(num_nodes >= 2);
+    tlsf_pool_set_root(p, head);
+}
+
+static void check_list(tlsf_persist_t *p)
+{
+    uint32_t expect = num_nodes;
+    for (node_t *n = (node_t *) tlsf_pool_root(p); n; n = n->next)
+        assert(n->value == --expect);
+    assert(expect == 0);
+}
+
+static void clean_reopen_test(void)
+{
+    tlsf_persist_t p;
+    assert(tlsf_pool_open(&p, path, 0, 0) == TLSF_OPEN_FAILED);
+    assert(tlsf_pool_open(&p, path, HEAP_SIZE, TLSF_PERSIST_CREATE) ==
+           TLSF_OPEN_CREATED);
+    assert(!tlsf_pool_root(&p));
+    build_list(&p);
+    tlsf_stats_t before;
+    tlsf_get_stats(p.tlsf, &before);
+    assert(!tlsf_pool_close(&p));
+
+    assert(tlsf_pool_open(&p, path, 0, 0) == TLSF_OPEN_RESUMED);
+    check_list(&p);
+    tlsf_check(p.tlsf);
+    tlsf_stats_t after;
+    tlsf_get_stats(p.tlsf, &after);
+    assert(after.total_used == before.total_used);
+    assert(after.free_count == before.free_count);
+    assert(!tlsf_pool_close(&p));
+
+    /* VERIFY rebuilds even after a clean close. */
+    assert(tlsf_pool_open(&p, path, 0, TLSF_PERSIST_VERIFY) ==
+           TLSF_OPEN_RECOVERED);
+    check_list(&p);
+    tlsf_check(p.tlsf);
+    assert(!tlsf_pool_close(&p));
+    printf("Clean reopen test: done\n");
+}
+
+/* The child frees half the list and allocates more, then dies without
+ * closing.  The parent must see its writes and a consistent heap.
+ */
+static void crash_test(void)
+{
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (!pid) {
+        tlsf_persist_t c;
+        if (tlsf_pool_open(&c, path, 0, 0) != TLSF_OPEN_RESUMED)
+            _exit(1);
+        node_t *n = (node_t *) tlsf_pool_root(&c);
+        for (uint32_t i = 0; i < num_nodes / 2; i++) {
+            node_t *next = n->next;
+            tlsf_free(c.tlsf, n);
+            n = next;
+        }
+        tlsf_pool_set_root(&c, n);
+        tlsf_malloc(c.tlsf, 16);
+        _exit(0);
+    }
+    int status;
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    tlsf_persist_t p;
+    assert(tlsf_pool_open(&p, path, 0, 0) == TLSF_OPEN_RECOVERED);
+    uint32_t left = num_nodes - num_nodes / 2, count = 0;
+    for (node_t *n = (node_t *) tlsf_pool_root(&p); n; n = n->next)
+        assert(n->value == left - 1 - count++);
+    assert(count == left);
+    tlsf_check(p.tlsf);
+    assert(!tlsf_pool_close(&p));
+    assert(tlsf_pool_open(&p, path, 0, 0) == TLSF_OPEN_RESUMED);
+    assert(!tlsf_pool_close(&p));
+    printf("Crash recovery test: done\n");
+}
+
+static void relocation_test(void)
+{
+    tlsf_persist_t p;
+    assert(tlsf_pool_open(&p, path, 0, 0) == TLSF_OPEN_RESUMED);
+    void *old = p.map;
+    size_t root = (size_t) ((char *) tlsf_pool_root(&p) - p.pool);
+    assert(!tlsf_pool_close(&p));
+
+    /* Occupy the recorded range so the heap must move. */
+    void *block = mmap(old, HEAP_SIZE, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    assert(block == old);
+    assert(tlsf_pool_open(&p, path, 0, 0) == TLSF_OPEN_RELOCATED);
+    assert(p.map != old);
+    assert((size_t) ((char *) tlsf_pool_root(&p) - p.pool) == root);
+    tlsf_check(p.tlsf);
+    /* New blocks come from the new mapping. */
+    char *q = (char *) tlsf_malloc(p.tlsf, 16);
+    if (q) {
+        assert(q >= p.pool && q < (char *) p.map + p.size);
+        tlsf_free(p.tlsf, q);
+    }
+    assert(!tlsf_pool_close(&p));
+    munmap(block, HEAP_SIZE);
+    printf("Relocation test: done\n");
+}
+
+static void damaged_chain_test(void)
+{
+    tlsf_persist_t p;
+    assert(tlsf_pool_open(&p, path, 0, 0) != TLSF_OPEN_FAILED);
+    /* Point the first block's size past the end of the pool. */
+    size_t *first = (size_t *) p.pool;
+    size_t saved = *first;
+    off_t pool = (off_t) (p.pool - (char *) p.map);
+    *first = (HEAP_SIZE * 2) | (saved & 3);
+    assert(!tlsf_pool_sync(&p));
+    munmap(p.map, p.size); /* Crash: no close */
+    close(p.fd);
+
+    /* The failed open must not touch the header. */
+    int fd = open(path, O_RDWR);
+    assert(fd >= 0);
+    static char before[4096], after[4096];
+    assert(pread(fd, before, sizeof(before), 0) == (ssize_t) sizeof(before));
+
+    errno = 0;
+    assert(tlsf_pool_open(&p, path, 0, 0) == TLSF_OPEN_FAILED);
+    assert(errno == EINVAL);
+    assert(pread(fd, after, sizeof(after), 0) == (ssize_t) sizeof(after));
+    assert(!memcmp(before, after, sizeof(before)));
+
+    /* Once the chain is repaired the heap opens again. */
+    assert(pwrite(fd, &saved, sizeof(saved), pool) == (ssize_t) sizeof(saved));
+    close(fd);
+    assert(tlsf_pool_open(&p, path, 0, 0) == TLSF_OPEN_RECOVERED);
+    tlsf_check(p.tlsf);
+    assert(!tlsf_pool_close(&p));
+    printf("Damaged chain test: done\n");
+}
+
+int main(void)
+{
+    snprintf(path, sizeof(path), "/tmp/tlsf-persist-%d", (int) getpid());
+    unlink(path);
+
+    clean_reopen_test();
+    crash_test();
+    relocation_test();
+    damaged_chain_test();
+
+    unlink(path);
+    printf("OK!\n");
+    return 0;
+}
@@ -0,0 +1,228 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * Sampling heap profiler test.
+ *
+ * Exact attribution with every allocation sampled, reallocs charged for
+ * growth only, then the estimate a Poisson-sampled profile gives for two
+ * call sites with known totals, the pprof dump format, and detaching
+ * with sampled blocks still live.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "tlsf_prof.h"
+
+#define ARENA_MAX ((size_t) 512 << 20)
+
+static char *arena;
+
+void *tlsf_resize(tlsf_t *t, size_t req_size)
+{
+    (void) t;
+    return req_size <= ARENA_MAX ? arena : NULL;
+}
+
+static char table[512 * 1024] __attribute__((aligned(16)));
+static void *ptrs_a[1 << 18], *ptrs_b[1 << 16];
+
+/* Two distinct call sites, kept out of line and unspecialized so the
+ * recorded return addresses fall inside them.
+ */
+#ifdef __clang__
+#define NOIPA __attribute__((noinline))
+#else
+#define NOIPA __attribute__((noipa))
+#endif
+
+NOIPA static void site_a(tlsf_t *t, size_t n, size_t sz)
+{
+    for (size_t i = 0; i < n; i++)
+        ptrs_a[i] = tlsf_malloc(t, sz);
+    __asm__ volatile("" ::: "memory");
+}
+
+NOIPA static void site_b(tlsf_t *t, size_t n, size_t sz)
+{
+    for (size_t i = 0; i < n; i++)
+        ptrs_b[i] = tlsf_malloc(t, sz);
+    __asm__ volatile("" ::: "memory");
+}
+
+/* The stack holding the closest return address past the start of fn:
+ * the call inside fn itself.
+ */
+static const tlsf_prof_stack_t *find_site(const tlsf_prof_t *p,
+                                          void (*fn)(void))
+{
+    const char *lo = (const char *) (uintptr_t) fn;
+    const tlsf_prof_stack_t *best = NULL;
+    size_t best_dist = 4096;
+    for (uint32_t i = 0; i <= p->stack_mask; i++) {
+        const tlsf_prof_stack_t *s = &p->stacks[i];
+        for (uint32_t d = 0; d < s->depth; d++) {
+            const char *pc = (const char *) s->pc[d];
+            if (pc > lo && (size_t) (pc - lo) < best_dist) {
+                best_dist = (size_t) (pc - lo);
+                best = s;
+            }
+        }
+    }
+    return best;
+}
+
+#define SITE(f) ((void (*)(void))(uintptr_t) (f))
+
+static void exact_test(void)
+{
+    tlsf_t t = TLSF_INIT;
+    tlsf_prof_t p;
+    assert(tlsf_prof_init(&p, &t, table, 64, 1) == -1);
+    assert(tlsf_prof_init(&p, &t, table, sizeof(table), 1) == 0);
+
+    site_a(&t, 10, 100);
+    site_b(&t, 5, 3000);
+    assert(p.nlive == 15 && p.nstack == 2 && !p.dropped);
+    const tlsf_prof_stack_t *a = find_site(&p, SITE(site_a));
+    const tlsf_prof_stack_t *b = find_site(&p, SITE(site_b));
+    assert(a && b && a != b);
+    assert(a->live_count == 10 && a->live_bytes == 10 * 104);
+    assert(b->live_count == 5 && b->live_bytes == 5 * 3000);
+
+    for (int i = 0; i < 4; i++)
+        tlsf_free(&t, ptrs_a[i]);
+    assert(a->live_count == 6 && a->alloc_count == 10);
+
+    /* realloc is a free of the old block plus a new sample. */
+    ptrs_a[4] = tlsf_realloc(&t, ptrs_a[4], 5000);
+    assert(ptrs_a[4] && p.nlive == 11);
+    assert(a->live_count == 5);
+    tlsf_check(&t);
+
+    /* A failed realloc keeps the block and its sample. */
+    assert(!tlsf_realloc(&t, ptrs_a[5], ARENA_MAX));
+    assert(p.nlive == 11 && a->live_count == 5);
+
+    /* Resized in place, a sampled block is sampled again at its new size,
+     * from the realloc call.
+     */
+    assert(tlsf_realloc(&t, ptrs_b[0], 1000) == ptrs_b[0]);
+    assert(p.nlive == 11 && b->live_count == 4);
+    tlsf_check(&t);
+
+    /* Detach with samples live: frees still work, nothing is recorded. */
+    tlsf_prof_stop(&p);
+    for (int i = 4; i < 10; i++)
+        tlsf_free(&t, ptrs_a[i]);
+    for (int i = 0; i < 5; i++)
+        tlsf_free(&t, ptrs_b[i]);
+    assert(p.nlive == 11);
+    tlsf_check(&t);
+    assert(!t.size);
+    printf("Exact attribution test: done\n");
+}
+
+/* In-place reallocs charge the countdown for growth only. */
+static void realloc_test(void)
+{
+    tlsf_t t = TLSF_INIT;
+    tlsf_prof_t p;
+    assert(tlsf_prof_init(&p, &t, table, sizeof(table), (size_t) 1 << 40) ==
+           0);
+
+    char *m = (char *) tlsf_malloc(&t, 2000);
+    void *n = tlsf_malloc(&t, 100);
+    assert(m && n);
+    ptrdiff_t countdown = t.prof_countdown;
+    assert(tlsf_realloc(&t, m, 512) == m);
+    assert(t.prof_countdown == countdown);
+    size_t avail = tlsf_usable_size(m);
+    assert(tlsf_realloc(&t, m, 1504) == m);
+    assert(countdown - t.prof_countdown == (ptrdiff_t) (1504 - avail));
+    assert(!p.nlive);
+
+    tlsf_free(&t, m);
+    tlsf_free(&t, n);
+    tlsf_check(&t);
+    tlsf_prof_stop(&p);
+    printf("Realloc charge test: done\n");
+}
+
+/* pprof's unsampling of one heap_v2 bucket. */
+static double estimate(size_t count, size_t bytes, size_t rate)
+{
+    if (!count)
+        return 0;
+    double avg = (double) bytes / (double) count;
+    return (double) bytes / (1 - exp(-avg / (double) rate));
+}
+
+static void sampled_test(void)
+{
+    const size_t rate = 32 * 1024, na = 200000, nb = 40000;
+    tlsf_t t = TLSF_INIT;
+    tlsf_prof_t p;
+    assert(tlsf_prof_init(&p, &t, table, sizeof(table), rate) == 0);
+
+    site_a(&t, na, 128);  /* 25.6 MB in small blocks */
+    site_b(&t, nb, 2000); /* 80 MB in larger blocks */
+    const tlsf_prof_stack_t *a = find_site(&p, SITE(site_a));
+    const tlsf_prof_stack_t *b = find_site(&p, SITE(site_b));
+    assert(a && b && !p.dropped);
+
+    double ea = estimate(a->live_count, a->live_bytes, rate);
+    double eb = estimate(b->live_count, b->live_bytes, rate);
+    printf("  site A: %zu samples, %.1f MB estimated, %.1f MB real\n",
+           a->live_count, ea / 1e6, (double) (na * 128) / 1e6);
+    printf("  site B: %zu samples, %.1f MB estimated, %.1f MB real\n",
+           b->live_count, eb / 1e6, (double) (nb * 2000) / 1e6);
+    assert(fabs(ea / (double) (na * 128) - 1) < 0.2);
+    assert(fabs(eb / (double) (nb * 2000) - 1) < 0.2);
+
+    /* Site B's memory is released; its cumulative figure stays. */
+    for (size_t i = 0; i < nb; i++)
+        tlsf_free(&t, ptrs_b[i]);
+    assert(!b->live_count && !b->live_bytes && b->alloc_count);
+
+    FILE *f = tmpfile();
+    assert(f && tlsf_prof_dump(&p, f) == 0);
+    rewind(f);
+    char line[4096];
+    assert(fgets(line, sizeof(line), f));
+    assert(!strncmp(line, "heap profile:", 13));
+    assert(strstr(line, "@ heap_v2/32768"));
+    int buckets = 0, maps = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strstr(line, "] @ 0x"))
+            buckets++;
+        if (!strcmp(line, "MAPPED_LIBRARIES:\n"))
+            maps = 1;
+    }
+    fclose(f);
+    assert(buckets == (int) p.nstack);
+    assert(maps);
+
+    for (size_t i = 0; i < na; i++)
+        tlsf_free(&t, ptrs_a[i]);
+    assert(!p.nlive);
+    tlsf_check(&t);
+    tlsf_prof_stop(&p);
+    printf("Sampled profile test: done\n");
+}
+
+int main(void)
+{
+    arena = (char *) mmap(NULL, ARENA_MAX, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    assert(arena != MAP_FAILED);
+    exact_test();
+    realloc_test();
+    sampled_test();
+    munmap(arena, ARENA_MAX);
+    printf("OK!\n");
+    return 0;
+}
@@ -0,0 +1,188 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * Region allocator test.
+ *
+ * Runs request-shaped workloads through tlsf_region_begin/alloc/end on a
+ * dynamic pool and checks alignment, that no two live objects overlap,
+ * nested scopes, chunk reuse across scopes, large blocks, exhaustion,
+ * and that destroy hands every byte back to the pool.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tlsf_region.h"
+
+#define ARENA_SIZE (4 * 1024 * 1024)
+#define CHUNK 4096
+#define MAX_OBJS 512
+
+static char arena[ARENA_SIZE] __attribute__((aligned(64)));
+static size_t arena_limit = ARENA_SIZE;
+
+void *tlsf_resize(tlsf_t *t, size_t req_size)
+{
+    (void) t;
+    return req_size <= arena_limit ? arena : NULL;
+}
+
+static unsigned char *objs[MAX_OBJS];
+static size_t lens[MAX_OBJS];
+static int nobjs;
+
+static void *alloc_obj(tlsf_region_t *r, size_t align, size_t size)
+{
+    unsigned char *p = (unsigned char *) tlsf_region_aalloc(r, align, size);
+    assert(p);
+    assert(!((uintptr_t) p & (align - 1)));
+    assert(nobjs < MAX_OBJS);
+    memset(p, nobjs & 0xff, size);
+    objs[nobjs] = p;
+    lens[nobjs++] = size;
+    return p;
+}
+
+/* Every live object still holds its own fill byte. */
+static void verify_objs(int from, int to)
+{
+    for (int i = from; i < to; i++)
+        for (size_t j = 0; j < lens[i]; j++)
+            assert(objs[i][j] == (unsigned char) (i & 0xff));
+}
+
+/* A request: mostly small objects, some aligned, a few large. */
+static void request(tlsf_region_t *r, unsigned seed)
+{
+    for (unsigned i = 0; i < 200; i++) {
+        unsigned x = (seed + i) * 2654435761u;
+        size_t size = 1 + (x >> 8) % 200;
+        size_t align = (x & 7) ? TLSF_REGION_ALIGN : 64;
+        if (i % 50 == 49)
+            size = 3000; /* Over a quarter of a chunk */
+        alloc_obj(r, align, size);
+    }
+}
+
+static size_t pool_used(tlsf_t *t)
+{
+    tlsf_check(t);
+    tlsf_stats_t st;
+    assert(tlsf_get_stats(t, &st) == 0);
+    return st.total_used;
+}
+
+static void scope_test(void)
+{
+    tlsf_t t = TLSF_INIT;
+    tlsf_region_t r;
+    tlsf_region_init(&r, &t, CHUNK, 4);
+    assert(pool_used(&t) == 0);
+
+    /* First request fills chunks and large blocks. */
+    tlsf_region_mark_t m = tlsf_region_begin(&r);
+    nobjs = 0;
+    request(&r, 1);
+    verify_objs(0, nobjs);
+    assert(r.chunks && r.large);
+    tlsf_region_end(&r, m);
+    assert(!r.chunks && !r.large && !r.cur);
+    assert(r.nspare == 4);
+    size_t kept = pool_used(&t);
+    assert(kept >= 4 * CHUNK);
+
+    /* Later requests run on the kept chunks; the pool sees only the
+     * large blocks come and go.
+     */
+    void *first = NULL;
+    for (unsigned round = 0; round < 20; round++) {
+        m = tlsf_region_begin(&r);
+        void *p = tlsf_region_alloc(&r, 16);
+        if (!first)
+            first = p;
+        assert(p == first);
+        nobjs = 0;
+        request(&r, round);
+        verify_objs(0, nobjs);
+        tlsf_region_end(&r, m);
+        assert(r.nspare == 4);
+        assert(pool_used(&t) == kept);
+    }
+
+    tlsf_region_destroy(&r);
+    assert(pool_used(&t) == 0);
+    printf("Scope test: done\n");
+}
+
+static void nested_test(void)
+{
+    tlsf_t t = TLSF_INIT;
+    tlsf_region_t r;
+    tlsf_region_init(&r, &t, CHUNK, 0);
+    nobjs = 0;
+
+    tlsf_region_mark_t outer = tlsf_region_begin(&r);
+    alloc_obj(&r, TLSF_REGION_ALIGN, 100);
+    size_t outer_used = pool_used(&t);
+
+    tlsf_region_mark_t inner = tlsf_region_begin(&r);
+    unsigned char *next = (unsigned char *) tlsf_region_alloc(&r, 8);
+    request(&r, 7);
+    tlsf_region_end(&r, inner);
+    /* The inner scope is gone: the next allocation takes its first slot,
+     * and with keep == 0 its chunks went back to the pool.
+     */
+    assert(tlsf_region_alloc(&r, 8) == next);
+    assert(pool_used(&t) == outer_used);
+    verify_objs(0, 1);
+
+    /* Ending the outer scope also drops an inner scope left open. */
+    tlsf_region_begin(&r);
+    request(&r, 8);
+    tlsf_region_end(&r, outer);
+    assert(pool_used(&t) == 0);
+
+    tlsf_region_destroy(&r);
+    printf("Nested scope test: done\n");
+}
+
+static void exhaustion_test(void)
+{
+    tlsf_t t = TLSF_INIT;
+    tlsf_region_t r;
+    arena_limit = 256 * 1024;
+    tlsf_region_init(&r, &t, 0, 1);
+    assert(r.chunk_size == TLSF_REGION_CHUNK);
+
+    tlsf_region_mark_t m = tlsf_region_begin(&r);
+    size_t got = 0;
+    while (tlsf_region_alloc(&r, 1000))
+        got++;
+    assert(got > 0);
+    assert(!tlsf_region_alloc(&r, SIZE_MAX));
+    assert(!tlsf_region_aalloc(&r, 4096, SIZE_MAX - 100));
+    tlsf_region_end(&r, m);
+
+    /* Space comes back after the scope ends. */
+    m = tlsf_region_begin(&r);
+    assert(tlsf_region_alloc(&r, 1000));
+    tlsf_region_end(&r, m);
+    tlsf_region_destroy(&r);
+    assert(pool_used(&t) == 0);
+    arena_limit = ARENA_SIZE;
+
+    /* Tiny chunk sizes are raised to the minimum. */
+    tlsf_region_init(&r, &t, 1, 0);
+    assert(r.chunk_size >= 1024);
+    printf("Exhaustion test: done\n");
+}
+
+int main(void)
+{
+    scope_test();
+    nested_test();
+    exhaustion_test();
+    printf("OK!\n");
+    return 0;
+}
@@ -0,0 +1,236 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * Process-shared heap test.
+ *
+ * One POSIX shared memory object is mapped several times, at different
+ * addresses, by the parent and by forked children.  Verifies:
+ *   - A block allocated through one mapping is readable and freeable
+ *     through another (position independence)
+ *   - Zero-copy message passing: a producer process hands out offsets,
+ *     the consumer reads and frees the messages in place
+ *   - Concurrent malloc/free from several processes keeps the heap intact
+ *   - A process dying while holding the lock does not wedge the heap
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "tlsf_shm.h"
+
+#define SEG_SIZE (4 * 1024 * 1024)
+#define NUM_PROCS 4
+#define OPS_PER_PROC 20000
+#define MAX_ALLOCS 64
+#define MAX_ALLOC_SIZE 1024
+#define NUM_MESSAGES 1000
+
+static int seg_fd = -1;
+
+/* Fresh mapping of the segment; the kernel picks a new address. */
+static void *seg_map(void)
+{
+    void *p =
+        mmap(NULL, SEG_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, seg_fd, 0);
+    assert(p != MAP_FAILED);
+    return p;
+}
+
+static void wait_children(int n)
+{
+    for (int i = 0; i < n; i++) {
+        int status;
+        assert(wait(&status) > 0);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+}
+
+static void two_mappings_test(tlsf_shm_t *a)
+{
+    void *view = seg_map();
+    tlsf_shm_t *b = tlsf_shm_attach(view, SEG_SIZE);
+    assert(b && (void *) b != (void *) a);
+
+    char *p = (char *) tlsf_shm_malloc(a, 100);
+    assert(p);
+    strcpy(p, "shared");
+
+    size_t off = tlsf_shm_offset(a, p);
+    char *q = (char *) tlsf_shm_ptr(b, off);
+    assert(q && q != p && !strcmp(q, "shared"));
+
+    /* Grow through one view, free through the other. */
+    q = (char *) tlsf_shm_realloc(b, q, 200);
+    assert(q && !strcmp(q, "shared"));
+    p = (char *) tlsf_shm_ptr(a, tlsf_shm_offset(b, q));
+    tlsf_shm_free(a, p);
+
+    assert(!tlsf_shm_ptr(a, 0) && !tlsf_shm_offset(a, NULL));
+    assert(!tlsf_shm_attach((char *) view + 64, SEG_SIZE - 64));
+
+    tlsf_shm_check(b);
+    munmap(view, SEG_SIZE);
+    printf("Two-mapping test: done\n");
+}
+
+/* Producer writes numbered messages and sends their offsets down a pipe;
+ * the parent reads each message from its own mapping and frees it.
+ */
+static void message_test(tlsf_shm_t *shm)
+{
+    int fds[2];
+    assert(!pipe(fds));
+
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (!pid) {
+        close(fds[0]);
+        tlsf_shm_t *c = tlsf_shm_attach(seg_map(), SEG_SIZE);
+        if (!c)
+            _exit(1);
+        for (uint32_t i = 0; i < NUM_MESSAGES; i++) {
+            size_t len = 16 + i % 256;
+            uint32_t *msg;
+            while (!(msg = (uint32_t *) tlsf_shm_malloc(c, len)))
+                sched_yield(); /* Consumer has not caught up yet */
+            msg[0] = i;
+            memset(msg + 1, (int) (i & 0xff), len - sizeof(*msg));
+            size_t off = tlsf_shm_offset(c, msg);
+            if (write(fds[1], &off, sizeof(off)) != sizeof(off))
+                _exit(1);
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    size_t off;
+    uint32_t expect = 0;
+    while (read(fds[0], &off, sizeof(off)) == sizeof(off)) {
+        uint32_t *msg = (uint32_t *) tlsf_shm_ptr(shm, off);
+        assert(msg && msg[0] == expect);
+        const unsigned char *body = (const unsigned char *) (msg + 1);
+        for (size_t j = 0; j < 16 + expect % 256 - sizeof(*msg); j++)
+            assert(body[j] == (expect & 0xff));
+        tlsf_shm_free(shm, msg);
+        expect++;
+    }
+    close(fds[0]);
+    wait_children(1);
+    assert(expect == NUM_MESSAGES);
+
+    tlsf_shm_check(shm);
+    printf("Message passing test: done\n");
+}
+
+static void stress_child(int id)
+{
+    tlsf_shm_t *shm = tlsf_shm_attach(seg_map(), SEG_SIZE);
+    if (!shm)
+        _exit(1);
+
+    unsigned char *ptrs[MAX_ALLOCS];
+    size_t sizes[MAX_ALLOCS];
+    int count = 0;
+    unsigned seed = (unsigned) id * 2654435761U + 7;
+
+    for (int op = 0; op < OPS_PER_PROC; op++) {
+        if (count < MAX_ALLOCS && (count == 0 || rand_r(&seed) % 2)) {
+            size_t sz = (size_t) (rand_r(&seed) % MAX_ALLOC_SIZE) + 1;
+            unsigned char *p = (unsigned char *) tlsf_shm_malloc(shm, sz);
+            if (p) {
+                memset(p, id, sz);
+                ptrs[count] = p;
+                sizes[count++] = sz;
+            }
+        } else if (count) {
+            int i = (int) ((unsigned) rand_r(&seed) % (unsigned) count);
+            for (size_t j = 0; j < sizes[i]; j++)
+                if (ptrs[i][j] != (unsigned char) id)
+                    _exit(2);
+            tlsf_shm_free(shm, ptrs[i]);
+            ptrs[i] = ptrs[--count];
+            sizes[i] = sizes[count];
+        }
+    }
+    while (count)
+        tlsf_shm_free(shm, ptrs[--count]);
+    _exit(0);
+}
+
+static void stress_test(tlsf_shm_t *shm)
+{
+    tlsf_stats_t before, after;
+    assert(!tlsf_shm_stats(shm, &before));
+
+    for (int i = 0; i < NUM_PROCS; i++) {
+        pid_t pid = fork();
+        assert(pid >= 0);
+        if (!pid)
+            stress_child(i + 1);
+    }
+    wait_children(NUM_PROCS);
+
+    tlsf_shm_check(shm);
+    assert(!tlsf_shm_stats(shm, &after));
+    assert(after.total_free == before.total_free);
+    assert(after.free_count == 1);
+    printf("Multi-process stress test: done\n");
+}
+
+/* A child takes the heap lock and exits without releasing it. */
+static void owner_death_test(tlsf_shm_t *shm)
+{
+    uint32_t deaths = tlsf_shm_owner_deaths(shm);
+
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (!pid) {
+        tlsf_shm_t *c = tlsf_shm_attach(seg_map(), SEG_SIZE);
+        if (!c || pthread_mutex_lock(&c->lock))
+            _exit(1);
+        _exit(0);
+    }
+    wait_children(1);
+
+    void *p = tlsf_shm_malloc(shm, 64);
+    assert(p);
+    tlsf_shm_free(shm, p);
+    assert(tlsf_shm_owner_deaths(shm) == deaths + 1);
+    tlsf_shm_check(shm);
+    printf("Owner death test: done\n");
+}
+
+int main(void)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/tlsf-test-%d", (int) getpid());
+    seg_fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    assert(seg_fd >= 0);
+    shm_unlink(name);
+    assert(!ftruncate(seg_fd, SEG_SIZE));
+
+    void *mem = seg_map();
+    tlsf_shm_t *shm = tlsf_shm_init(mem, SEG_SIZE);
+    assert(shm);
+    assert(tlsf_shm_attach(mem, SEG_SIZE) == shm);
+    assert(!tlsf_shm_attach(mem, SEG_SIZE / 2));
+
+    two_mappings_test(shm);
+    message_test(shm);
+    stress_test(shm);
+    owner_death_test(shm);
+
+    tlsf_shm_destroy(shm);
+    assert(!tlsf_shm_attach(mem, SEG_SIZE));
+    munmap(mem, SEG_SIZE);
+    close(seg_fd);
+    printf("OK!\n");
+    return 0;
+}
@@ -0,0 +1,152 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * Snapshot / restore test for both backends.
+ *
+ * For each backend: fill some blocks, snapshot, then free, reallocate
+ * and scribble over everything before restoring.  After the restore the
+ * pre-snapshot pointers must hold their old contents, the heap must pass
+ * tlsf_check() and report the same statistics as at the snapshot, and
+ * the blocks must be freeable.  The COW backend additionally must only
+ * touch the pages that were written.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tlsf_snapshot.h"
+
+#define POOL_SIZE (4 * 1024 * 1024)
+#define MAX_BLOCKS 16
+#define ROUNDS 20
+
+static void *blocks[MAX_BLOCKS];
+static size_t sizes[MAX_BLOCKS];
+static int nblocks;
+
+/* Allocate up to MAX_BLOCKS blocks, each filled with its index. */
+static void fill(tlsf_t *t)
+{
+    for (nblocks = 0; nblocks < MAX_BLOCKS; nblocks++) {
+        sizes[nblocks] = 64 + (size_t) nblocks * 512;
+        blocks[nblocks] = tlsf_malloc(t, sizes[nblocks]);
+        if (!blocks[nblocks])
+            break;
+        memset(blocks[nblocks], nblocks + 1, sizes[nblocks]);
+    }
+    assert(nblocks >= 2);
+}
+
+static void verify(tlsf_t *t, const tlsf_stats_t *expect)
+{
+    for (int i = 0; i < nblocks; i++) {
+        const unsigned char *p = (const unsigned char *) blocks[i];
+        for (size_t j = 0; j < sizes[i]; j++)
+            assert(p[j] == (unsigned char) (i + 1));
+    }
+    tlsf_check(t);
+    tlsf_stats_t st;
+    assert(tlsf_get_stats(t, &st) == 0);
+    assert(st.total_used == expect->total_used);
+    assert(st.free_count == expect->free_count);
+    assert(st.largest_free == expect->largest_free);
+}
+
+/* Undo everything since the snapshot in as many ways as possible. */
+static void mutate(tlsf_t *t, int round)
+{
+    for (int i = 0; i < nblocks; i += 2)
+        tlsf_free(t, blocks[i]);
+    void *p = tlsf_malloc(t, 100 + (size_t) round);
+    if (p)
+        memset(p, 0xee, 100);
+    for (int i = 1; i < nblocks; i += 2)
+        memset(blocks[i], 0xdd, sizes[i]);
+}
+
+static void round_trip(tlsf_snapshot_t *s, tlsf_t *t)
+{
+    fill(t);
+    assert(tlsf_snapshot(s) == 0);
+    tlsf_stats_t at_snapshot;
+    assert(tlsf_get_stats(t, &at_snapshot) == 0);
+
+    for (int r = 0; r < ROUNDS; r++) {
+        mutate(t, r);
+        assert(tlsf_restore(s) == 0);
+        verify(t, &at_snapshot);
+    }
+
+    /* The restored pool is fully usable. */
+    for (int i = 0; i < nblocks; i++)
+        tlsf_free(t, blocks[i]);
+    tlsf_check(t);
+    tlsf_stats_t st;
+    assert(tlsf_get_stats(t, &st) == 0);
+    assert(st.free_count == 1 && st.total_used == 0);
+}
+
+static void copy_test(void)
+{
+    static char pool[POOL_SIZE] __attribute__((aligned(16)));
+    static char copy[POOL_SIZE];
+    tlsf_t t;
+    tlsf_snapshot_t s;
+
+    assert(tlsf_pool_init(&t, pool, sizeof(pool)));
+    assert(tlsf_snapshot_init(&s, &t, copy, 64) == -1);
+    assert(tlsf_snapshot_init(&s, &t, copy, sizeof(copy)) == 0);
+    round_trip(&s, &t);
+
+    tlsf_t dynamic = TLSF_INIT;
+    assert(tlsf_snapshot_init(&s, &dynamic, copy, sizeof(copy)) == -1);
+    printf("Copy snapshot test: done\n");
+}
+
+static void cow_test(void)
+{
+    tlsf_t t;
+    tlsf_snapshot_t s;
+    if (!tlsf_snapshot_pool_init(&s, &t, POOL_SIZE)) {
+        printf("COW snapshot test: skipped (no memfd)\n");
+        return;
+    }
+    round_trip(&s, &t);
+
+    /* Restoring after a one-byte write drops only that page, when the
+     * kernel lets us read the page-table flags.
+     */
+    tlsf_snapshot_destroy(&s);
+    assert(tlsf_snapshot_pool_init(&s, &t, POOL_SIZE));
+    char *p = (char *) tlsf_malloc(&t, 32);
+    assert(p);
+    *p = 1;
+    assert(tlsf_snapshot(&s) == 0);
+    *p = 2;
+    assert(tlsf_restore(&s) == 0);
+    assert(*p == 1);
+    if (s.pagemap >= 0)
+        assert(s.dirty == 1);
+    else
+        assert(s.dirty == POOL_SIZE / (size_t) sysconf(_SC_PAGESIZE));
+
+    /* A restore with nothing written touches nothing. */
+    assert(tlsf_restore(&s) == 0);
+    if (s.pagemap >= 0)
+        assert(s.dirty == 0);
+    tlsf_free(&t, p);
+    tlsf_check(&t);
+
+    tlsf_snapshot_destroy(&s);
+    printf("COW snapshot test: done\n");
+}
+
+int main(void)
+{
+    copy_test();
+    cow_test();
+    printf("OK!\n");
+    return 0;
+}
@@ -0,0 +1,171 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * Static tracepoint test (TLSF_USDT).
+ *
+ * Reads the .note.stapsdt section of this executable, the way bpftrace
+ * and perf discover probes, and checks that every allocator probe is
+ * present with the documented argument count, that each probe address
+ * holds a nop at run time, and that the allocator still works with the
+ * probes compiled in.
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <elf.h>
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tlsf_thread.h"
+
+#define ARENA_SIZE (4 * 1024 * 1024)
+
+static char arena[ARENA_SIZE] __attribute__((aligned(16)));
+
+void *tlsf_resize(tlsf_t *t, size_t req_size)
+{
+    (void) t;
+    return req_size <= ARENA_SIZE ? arena : NULL;
+}
+
+static const struct {
+    const char *provider, *name;
+    int nargs;
+} expected[] = {
+    {"tlsf", "malloc", 5},        {"tlsf", "aalloc", 6},
+    {"tlsf", "realloc", 4},       {"tlsf", "free", 3},
+    {"tlsf", "grow", 4},          {"tlsf", "shrink", 3},
+    {"tlsf_thread", "fallback", 6}, {"tlsf_thread", "migrate", 5},
+};
+#define NEXPECTED (sizeof(expected) / sizeof(expected[0]))
+
+static unsigned found[NEXPECTED];
+
+static uintptr_t load_bias(void)
+{
+    extern char __executable_start[];
+    Dl_info info;
+    struct link_map *map;
+    assert(dladdr1(__executable_start, &info, (void **) &map,
+                   RTLD_DL_LINKMAP));
+    return (uintptr_t) map->l_addr;
+}
+
+static int count_args(const char *args)
+{
+    int n = 0;
+    for (const char *p = args; (p = strstr(p, "8@")); p += 2) {
+        assert(p == args || p[-1] == ' ');
+        n++;
+    }
+    return n;
+}
+
+static void check_note(const char *desc, uint64_t base_addr, uintptr_t bias)
+{
+    uint64_t pc, base, sem;
+    memcpy(&pc, desc, 8);
+    memcpy(&base, desc + 8, 8);
+    memcpy(&sem, desc + 16, 8);
+    const char *provider = desc + 24;
+    const char *name = provider + strlen(provider) + 1;
+    const char *args = name + strlen(name) + 1;
+
+    assert(base == base_addr);
+    assert(!sem);
+#if defined(__x86_64__)
+    assert(*(const unsigned char *) (bias + pc) == 0x90);
+#elif defined(__aarch64__)
+    assert(*(const uint32_t *) (bias + pc) == 0xd503201f);
+#endif
+
+    for (size_t i = 0; i < NEXPECTED; i++) {
+        if (!strcmp(provider, expected[i].provider) &&
+            !strcmp(name, expected[i].name)) {
+            assert(count_args(args) == expected[i].nargs);
+            found[i]++;
+            return;
+        }
+    }
+    fprintf(stderr, "unexpected probe %s:%s\n", provider, name);
+    abort();
+}
+
+static void note_test(void)
+{
+    FILE *f = fopen("/proc/self/exe", "rb");
+    assert(f);
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    char *img = (char *) malloc((size_t) len);
+    assert(img);
+    fseek(f, 0, SEEK_SET);
+    assert(fread(img, 1, (size_t) len, f) == (size_t) len);
+    fclose(f);
+
+    const Elf64_Ehdr *eh = (const Elf64_Ehdr *) img;
+    assert(!memcmp(eh->e_ident, ELFMAG, SELFMAG));
+    const Elf64_Shdr *sh = (const Elf64_Shdr *) (img + eh->e_shoff);
+    const char *names = img + sh[eh->e_shstrndx].sh_offset;
+
+    const Elf64_Shdr *notes = NULL;
+    uint64_t base_addr = 0;
+    for (unsigned i = 0; i < eh->e_shnum; i++) {
+        if (!strcmp(names + sh[i].sh_name, ".note.stapsdt"))
+            notes = &sh[i];
+        if (!strcmp(names + sh[i].sh_name, ".stapsdt.base"))
+            base_addr = sh[i].sh_addr;
+    }
+    assert(notes && base_addr);
+
+    uintptr_t bias = load_bias();
+    unsigned total = 0;
+    for (size_t off = 0; off < notes->sh_size;) {
+        const Elf64_Nhdr *nh =
+            (const Elf64_Nhdr *) (img + notes->sh_offset + off);
+        const char *owner = (const char *) (nh + 1);
+        const char *desc = owner + ((nh->n_namesz + 3) & ~3U);
+        assert(nh->n_type == 3 && !strcmp(owner, "stapsdt"));
+        check_note(desc, base_addr, bias);
+        total++;
+        off += sizeof(*nh) + ((nh->n_namesz + 3) & ~3U) +
+               ((nh->n_descsz + 3) & ~3U);
+    }
+    for (size_t i = 0; i < NEXPECTED; i++)
+        assert(found[i] > 0);
+    free(img);
+    printf("Probe notes test: %u probe sites, done\n", total);
+}
+
+static void alloc_test(void)
+{
+    tlsf_t t = TLSF_INIT;
+    void *p = tlsf_malloc(&t, 100);
+    void *q = tlsf_aalloc(&t, 256, 1000);
+    assert(p && q && !((uintptr_t) q & 255));
+    p = tlsf_realloc(&t, p, 5000);
+    assert(p);
+    tlsf_free(&t, q);
+    tlsf_free(&t, p);
+    tlsf_check(&t);
+
+    tlsf_thread_t ts;
+    assert(tlsf_thread_init(&ts, arena, sizeof(arena)));
+    /* Larger than one arena: the preferred arena fails and falls back. */
+    assert(!tlsf_thread_malloc(&ts, ARENA_SIZE));
+    void *r = tlsf_thread_malloc(&ts, 64);
+    assert(r);
+    tlsf_thread_free(&ts, r);
+    tlsf_thread_check(&ts);
+    tlsf_thread_destroy(&ts);
+    printf("Allocation test: done\n");
+}
+
+int main(void)
+{
+    note_test();
+    alloc_test();
+    printf("OK!\n");
+    return 0;
+}
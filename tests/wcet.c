@@ -20,6 +20,14 @@
  *   malloc: Exact bin hit, no split required.
  *   free:   No merge possible (used neighbors on both sides).
  *
+ * Two start-up scenarios time the first allocations from a fresh pool,
+ * without and with tlsf_reserve() carving their blocks in advance.
+ *
+ * Two first-touch scenarios time malloc plus the first store to each page
+ * of the block in never-used memory, without and with
+ * tlsf_pool_prefault(): the page faults that the algorithmic bound
+ * leaves out.
+ *
  * Timing: rdtsc on x86-64, cntvct_el0 on ARM64, clock_gettime fallback.
  * Addresses TLSF-WCET limitations: clock() resolution, single-size
  * testing, no optimization-level variation.
@@ -33,6 +41,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 #ifdef __APPLE__
@@ -308,21 +317,8 @@ static void measure_malloc_best(char *pool,
     }
 }
 
-/*
- * Allocate three adjacent blocks of the requested size from a static pool.
- *
- * TLSF's block_find_free updates the request size to mapping_size(found_bin),
- * which can be far larger than the original request when the pool has a
- * single huge free block (e.g., requesting 1024 from a 4MB pool allocates
- * ~4MB due to bin-minimum inflation).  This prevents multiple allocations
- * from a fresh pool.
- *
- * Workaround: allocate each block at the inflated size, then immediately
- * realloc down to the target size.  Realloc's trim path (block_rtrim_used)
- * splits the oversized block, returning the excess to the free list.
- * The excess merges with any adjacent free block, making space for the
- * next allocation.  After three malloc+realloc cycles, we have three
- * adjacent blocks of the correct size.
+/* Allocate three adjacent blocks of the requested size from a fresh
+ * static pool.  Each is split off the front of the single free block.
  */
 static void alloc_three_blocks(tlsf_t *t,
                                size_t alloc_size,
@@ -332,25 +328,17 @@ static void alloc_three_blocks(tlsf_t *t,
 {
     *a = tlsf_malloc(t, alloc_size);
     assert(*a);
-    *a = tlsf_realloc(t, *a, alloc_size);
-    assert(*a);
-
     *b = tlsf_malloc(t, alloc_size);
     assert(*b);
-    *b = tlsf_realloc(t, *b, alloc_size);
-    assert(*b);
-
     *c = tlsf_malloc(t, alloc_size);
     assert(*c);
-    *c = tlsf_realloc(t, *c, alloc_size);
-    assert(*c);
 }
 
 /*
  * free worst case: Block sandwiched between two free neighbors.
  *
- * Setup: allocate three adjacent blocks A, B, C using the
- * alloc+realloc trick (see alloc_three_blocks), then free A
+ * Setup: allocate three adjacent blocks A, B, C from a fresh pool
+ * (see alloc_three_blocks), then free A
  * (left neighbor becomes free) and free C (right neighbor merges
  * with the pool remainder, creating a large free block).
  * Now B has a free block on each side.
@@ -398,10 +386,9 @@ static void measure_free_worst(char *pool,
 /*
  * free best case: Block between two used neighbors (no merge).
  *
- * Setup: allocate three adjacent blocks A, B, C (using the
- * alloc+realloc trick).  All remain allocated.  Freeing B finds used
- * blocks on both sides, so block_merge_prev and block_merge_next both
- * skip.  Only a single list insertion occurs.
+ * Setup: allocate three adjacent blocks A, B, C.  All remain allocated.
+ * Freeing B finds used blocks on both sides, so block_merge_prev and
+ * block_merge_next both skip.  Only a single list insertion occurs.
  *
  * Minimal path: block_from_payload -> block_set_free -> block_link_next
  *   -> block_merge_prev (skip) -> block_merge_next (skip) ->
@@ -436,6 +423,239 @@ static void measure_free_best(char *pool,
     }
 }
 
+/*
+ * Batched free: BATCH_BLOCKS scattered blocks, each sandwiched between
+ * free neighbours, released in shuffled order.  free_loop calls
+ * tlsf_free() per pointer; free_batch hands the same pointers to
+ * tlsf_free_batch(), which prefetches ahead.  Samples are per pointer
+ * (batch time / BATCH_BLOCKS), so they compare directly with free_worst.
+ * Run with -C: with a hot cache there are no misses to overlap.
+ */
+#define BATCH_BLOCKS 32
+
+static void setup_batch(tlsf_t *t,
+                        char *pool,
+                        size_t pool_size,
+                        size_t alloc_size,
+                        void **batch)
+{
+    void *blocks[2 * BATCH_BLOCKS + 1];
+
+    tlsf_pool_init(t, pool, pool_size);
+    for (size_t i = 0; i < 2 * BATCH_BLOCKS + 1; i++) {
+        blocks[i] = tlsf_malloc(t, alloc_size);
+        assert(blocks[i]);
+    }
+    for (size_t i = 0; i < 2 * BATCH_BLOCKS + 1; i += 2)
+        tlsf_free(t, blocks[i]);
+
+    /* Fixed shuffle so the hardware prefetcher sees no stride. */
+    for (size_t i = 0; i < BATCH_BLOCKS; i++)
+        batch[i] = blocks[2 * i + 1];
+    uint32_t seed = 12345;
+    for (size_t i = BATCH_BLOCKS - 1; i > 0; i--) {
+        seed = seed * 1103515245U + 12345U;
+        size_t j = (seed >> 16) % (i + 1);
+        void *tmp = batch[i];
+        batch[i] = batch[j];
+        batch[j] = tmp;
+    }
+}
+
+static void measure_free_batched(char *pool,
+                                 size_t pool_size,
+                                 size_t alloc_size,
+                                 size_t iterations,
+                                 size_t warmup,
+                                 tick_t *samples,
+                                 bool batched)
+{
+    tlsf_t t;
+    void *batch[BATCH_BLOCKS];
+
+    for (size_t i = 0; i < warmup + iterations; i++) {
+        setup_batch(&t, pool, pool_size, alloc_size, batch);
+        if (i >= warmup)
+            cache_thrash();
+
+        tick_t start = read_tick();
+        if (batched) {
+            tlsf_free_batch(&t, batch, BATCH_BLOCKS);
+        } else {
+            for (size_t j = 0; j < BATCH_BLOCKS; j++)
+                tlsf_free(&t, batch[j]);
+        }
+        tick_t end = read_tick();
+
+        if (i >= warmup)
+            samples[i - warmup] = (end - start) / BATCH_BLOCKS;
+    }
+}
+
+static void measure_free_loop(char *pool,
+                              size_t pool_size,
+                              size_t alloc_size,
+                              size_t iterations,
+                              size_t warmup,
+                              tick_t *samples)
+{
+    measure_free_batched(pool, pool_size, alloc_size, iterations, warmup,
+                         samples, false);
+}
+
+static void measure_free_batch(char *pool,
+                               size_t pool_size,
+                               size_t alloc_size,
+                               size_t iterations,
+                               size_t warmup,
+                               tick_t *samples)
+{
+    measure_free_batched(pool, pool_size, alloc_size, iterations, warmup,
+                         samples, true);
+}
+
+/*
+ * First allocations from a fresh pool: FIRST_N mallocs of one size right
+ * after tlsf_pool_init(), each sampled.  Every one of them splits the
+ * single huge free block, the malloc_worst path.  first_reserved calls
+ * tlsf_reserve() for FIRST_N blocks of the size after init, untimed, so
+ * every allocation is an exact bin hit, the malloc_best path.
+ */
+#define FIRST_N 32
+
+static void measure_first(char *pool,
+                          size_t pool_size,
+                          size_t alloc_size,
+                          size_t iterations,
+                          size_t warmup,
+                          tick_t *samples,
+                          bool reserve)
+{
+    tlsf_t t;
+
+    for (size_t i = 0; i < warmup + iterations; i++) {
+        if (i % FIRST_N == 0) {
+            tlsf_pool_init(&t, pool, pool_size);
+            if (reserve && !tlsf_reserve(&t, alloc_size, FIRST_N)) {
+                fprintf(stderr, "tlsf_reserve failed\n");
+                exit(1);
+            }
+        }
+        if (i >= warmup)
+            cache_thrash();
+
+        tick_t start = read_tick();
+        void *p = tlsf_malloc(&t, alloc_size);
+        tick_t end = read_tick();
+
+        assert(p);
+        (void) p;
+        if (i >= warmup)
+            samples[i - warmup] = end - start;
+    }
+}
+
+static void measure_first_plain(char *pool,
+                                size_t pool_size,
+                                size_t alloc_size,
+                                size_t iterations,
+                                size_t warmup,
+                                tick_t *samples)
+{
+    measure_first(pool, pool_size, alloc_size, iterations, warmup, samples,
+                  false);
+}
+
+static void measure_first_reserved(char *pool,
+                                   size_t pool_size,
+                                   size_t alloc_size,
+                                   size_t iterations,
+                                   size_t warmup,
+                                   tick_t *samples)
+{
+    measure_first(pool, pool_size, alloc_size, iterations, warmup, samples,
+                  true);
+}
+
+/*
+ * First-touch allocation: tlsf_malloc() plus one store per page of the
+ * new block, walking forward through memory the process has never
+ * touched.  Every scenario above recycles one warm pool and never pays
+ * for a page fault; here the timed operation takes one whenever the
+ * block, or the remainder header written by the split, reaches a fresh
+ * page, as it does in a program that has not yet used its whole pool.
+ * Few samples fault at small sizes, so watch p99.9 and max.
+ *
+ * Each pool is a fresh anonymous mapping, replaced (untimed) once half of
+ * it is allocated.  touch_prefault calls tlsf_pool_prefault() on each new
+ * pool first, which leaves only the allocator's own cost.
+ */
+static void measure_touch(size_t pool_size,
+                          size_t alloc_size,
+                          size_t iterations,
+                          size_t warmup,
+                          tick_t *samples,
+                          bool prefault)
+{
+    const size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t per_pool = pool_size / (2 * (alloc_size + 64));
+    if (!per_pool)
+        per_pool = 1;
+    tlsf_t t;
+    char *mem = NULL;
+
+    for (size_t i = 0; i < warmup + iterations; i++) {
+        if (i % per_pool == 0) {
+            if (mem)
+                munmap(mem, pool_size);
+            mem = (char *) mmap(NULL, pool_size, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            assert(mem != MAP_FAILED);
+            tlsf_pool_init(&t, mem, pool_size);
+            if (prefault && tlsf_pool_prefault(&t, 0)) {
+                fprintf(stderr, "tlsf_pool_prefault failed\n");
+                exit(1);
+            }
+        }
+        if (i >= warmup)
+            cache_thrash();
+
+        tick_t start = read_tick();
+        volatile char *p = (volatile char *) tlsf_malloc(&t, alloc_size);
+        for (size_t off = 0; off < alloc_size; off += page)
+            p[off] = 0;
+        p[alloc_size - 1] = 0;
+        tick_t end = read_tick();
+
+        assert(p);
+        if (i >= warmup)
+            samples[i - warmup] = end - start;
+    }
+    munmap(mem, pool_size);
+}
+
+static void measure_touch_fault(char *pool,
+                                size_t pool_size,
+                                size_t alloc_size,
+                                size_t iterations,
+                                size_t warmup,
+                                tick_t *samples)
+{
+    (void) pool;
+    measure_touch(pool_size, alloc_size, iterations, warmup, samples, false);
+}
+
+static void measure_touch_prefault(char *pool,
+                                   size_t pool_size,
+                                   size_t alloc_size,
+                                   size_t iterations,
+                                   size_t warmup,
+                                   tick_t *samples)
+{
+    (void) pool;
+    measure_touch(pool_size, alloc_size, iterations, warmup, samples, true);
+}
+
 /* --- Configuration --- */
 
 static const size_t test_sizes[] = {16, 64, 256, 1024, 4096};
@@ -455,6 +675,18 @@ static const scenario_t scenarios[] = {
     {"malloc_best", "exact bin hit, no split", measure_malloc_best},
     {"free_worst", "sandwiched between two free blocks", measure_free_worst},
     {"free_best", "no merge (used neighbors)", measure_free_best},
+    {"free_loop", "32 sandwiched blocks, tlsf_free each (per ptr)",
+     measure_free_loop},
+    {"free_batch", "same 32 blocks via tlsf_free_batch (per ptr)",
+     measure_free_batch},
+    {"first_plain", "first 32 mallocs from a fresh pool",
+     measure_first_plain},
+    {"first_reserved", "same after tlsf_reserve() of 32 blocks",
+     measure_first_reserved},
+    {"touch_fault", "malloc + first store to fresh pages",
+     measure_touch_fault},
+    {"touch_prefault", "same after tlsf_pool_prefault()",
+     measure_touch_prefault},
 };
 #define NUM_SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
 